@@ -16,11 +16,26 @@
 #include "tcg/tcg.h"
 #include "exec/cpu-common.h"
 #include "exec/exec-all.h"
+#include "perf.h"
 
 void tb_flush(CPUState *cpu)
 {
 }
 
+#ifdef CONFIG_LINUX
+void perf_enable_perfmap(void)
+{
+}
+
+void perf_enable_jitdump(void)
+{
+}
+#endif
+
+void tb_hot_set_threshold(unsigned threshold)
+{
+}
+
 void tb_unlock(void)
 {
 }
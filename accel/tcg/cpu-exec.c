@@ -421,7 +421,13 @@ static inline TranslationBlock *tb_find(CPUState *cpu,
             tb_lock();
             acquired_tb_lock = true;
         }
-        if (!(tb->cflags & CF_INVALID)) {
+        /* last_tb may have been invalidated since it ran, by another
+         * thread writing to its guest code or by itself (see
+         * tb_mark_hot).  Once on the jump list of TB it would stay there
+         * after its region is evicted and reused, and unlinking TB would
+         * then patch unrelated code.
+         */
+        if (!(tb->cflags & CF_INVALID) && !(last_tb->cflags & CF_INVALID)) {
             tb_add_jump(last_tb, tb_exit, tb);
         }
     }
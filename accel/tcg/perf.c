@@ -0,0 +1,343 @@
+/*
+ * Linux perf perf-<pid>.map and jit-<pid>.dump integration.
+ *
+ * perf-<pid>.map is a text file mapping host address ranges to names,
+ * which perf report reads as is.  It has no notion of time, so a host
+ * address reused after tb_flush would be attributed to whatever TB was
+ * described first; the map is therefore restarted on each flush.
+ *
+ * jit-<pid>.dump records every load of code with a timestamp and a copy
+ * of the code itself, so "perf inject --jit" can resolve samples taken
+ * before and after a flush, and annotate the host instructions.  Record
+ * with "perf record -k 1" so that the timestamps match.
+ *
+ * Both files are named after the pid, so a child created by fork() in
+ * linux-user starts its own files rather than writing to its parent's.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu-common.h"
+#include "cpu.h"
+#include "disas/disas.h"
+#include "qemu/error-report.h"
+#include "exec/exec-all.h"
+#include "exec/tb-context.h"
+#include "tcg.h"
+#include "perf.h"
+
+static pid_t perf_pid;
+static FILE *perfmap;
+static FILE *jitdump;
+static void *jitdump_marker;
+static size_t jitdump_marker_size;
+static uint64_t jitdump_code_index;
+static bool prologue_reported;
+
+/* jitdump format, see tools/perf/Documentation/jitdump-specification.txt
+ * in the Linux sources.  */
+#define JITDUMP_MAGIC   0x4A695444
+#define JITDUMP_VERSION 1
+
+enum {
+    JIT_CODE_LOAD = 0,
+    JIT_CODE_CLOSE = 3,
+};
+
+struct jitheader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t total_size;
+    uint32_t elf_mach;
+    uint32_t pad1;
+    uint32_t pid;
+    uint64_t timestamp;
+    uint64_t flags;
+};
+
+struct jr_prefix {
+    uint32_t id;
+    uint32_t total_size;
+    uint64_t timestamp;
+};
+
+struct jr_code_load {
+    struct jr_prefix p;
+    uint32_t pid;
+    uint32_t tid;
+    uint64_t vma;
+    uint64_t code_addr;
+    uint64_t code_size;
+    uint64_t code_index;
+    /* followed by the NUL-terminated name and the code bytes */
+};
+
+/* perf correlates the records with CLOCK_MONOTONIC samples.  */
+static uint64_t jitdump_timestamp(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* The ELF machine of the host, read back from our own executable.  */
+static uint16_t host_elf_machine(void)
+{
+    uint16_t e_machine = 0;
+    int fd = open("/proc/self/exe", O_RDONLY);
+
+    if (fd >= 0) {
+        /* e_machine has the same offset in ELF32 and ELF64 headers.  */
+        if (pread(fd, &e_machine, sizeof(e_machine), 18) !=
+            sizeof(e_machine)) {
+            e_machine = 0;
+        }
+        close(fd);
+    }
+    return e_machine;
+}
+
+static void perf_open_perfmap(void)
+{
+    char *name = g_strdup_printf("/tmp/perf-%d.map", getpid());
+
+    perfmap = fopen(name, "w");
+    if (!perfmap) {
+        warn_report("Could not open %s: %s, proceeding without perfmap",
+                    name, strerror(errno));
+    }
+    g_free(name);
+}
+
+static void perf_open_jitdump(void)
+{
+    struct jitheader header;
+    char *name = g_strdup_printf("jit-%d.dump", getpid());
+    int fd;
+
+    fd = open(name, O_CREAT | O_TRUNC | O_RDWR, 0666);
+    if (fd < 0) {
+        warn_report("Could not open %s: %s, proceeding without jitdump",
+                    name, strerror(errno));
+        goto out;
+    }
+
+    /* perf record notices the dump through an executable mapping of it.  */
+    jitdump_marker_size = getpagesize();
+    jitdump_marker = mmap(NULL, jitdump_marker_size, PROT_READ | PROT_EXEC,
+                          MAP_PRIVATE, fd, 0);
+    if (jitdump_marker == MAP_FAILED) {
+        warn_report("Could not map %s: %s, proceeding without jitdump",
+                    name, strerror(errno));
+        jitdump_marker = NULL;
+        close(fd);
+        goto out;
+    }
+
+    jitdump = fdopen(fd, "w+");
+    if (!jitdump) {
+        warn_report("Could not open %s: %s, proceeding without jitdump",
+                    name, strerror(errno));
+        munmap(jitdump_marker, jitdump_marker_size);
+        jitdump_marker = NULL;
+        close(fd);
+        goto out;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = JITDUMP_MAGIC;
+    header.version = JITDUMP_VERSION;
+    header.total_size = sizeof(header);
+    header.elf_mach = host_elf_machine();
+    header.pid = getpid();
+    header.timestamp = jitdump_timestamp();
+    fwrite(&header, sizeof(header), 1, jitdump);
+    fflush(jitdump);
+
+out:
+    g_free(name);
+}
+
+static void perf_register_exit(void)
+{
+    static bool registered;
+
+    if (!registered) {
+        atexit(perf_exit);
+        registered = true;
+    }
+    perf_pid = getpid();
+}
+
+void perf_enable_perfmap(void)
+{
+    perf_open_perfmap();
+    if (perfmap) {
+        perf_register_exit();
+    }
+}
+
+void perf_enable_jitdump(void)
+{
+    perf_open_jitdump();
+    if (jitdump) {
+        perf_register_exit();
+    }
+}
+
+static void perf_report_code_name(const void *start, size_t size,
+                                  const char *name, bool map_only)
+{
+    if (perfmap) {
+        fprintf(perfmap, "%" PRIxPTR " %zx %s\n",
+                (uintptr_t)start, size, name);
+        fflush(perfmap);
+    }
+    if (jitdump && !map_only) {
+        struct jr_code_load load;
+        size_t name_size = strlen(name) + 1;
+
+        load.p.id = JIT_CODE_LOAD;
+        load.p.total_size = sizeof(load) + name_size + size;
+        load.p.timestamp = jitdump_timestamp();
+        load.pid = getpid();
+        load.tid = qemu_get_thread_id();
+        load.vma = (uintptr_t)start;
+        load.code_addr = (uintptr_t)start;
+        load.code_size = size;
+        load.code_index = jitdump_code_index++;
+        fwrite(&load, sizeof(load), 1, jitdump);
+        fwrite(name, name_size, 1, jitdump);
+        fwrite(start, size, 1, jitdump);
+        fflush(jitdump);
+    }
+}
+
+/* Called with tb_lock held, or before the vCPUs are started.  The
+ * files are flushed after every record because the guest may end the
+ * process with a raw exit_group, which bypasses atexit handlers.
+ */
+static void perf_report_tb_code(uint64_t pc, const void *start, size_t size,
+                                bool map_only)
+{
+    const char *symbol;
+    char *name;
+
+    if (!prologue_reported) {
+        /* The prologue sits right before the region buffers.  */
+        uint8_t *prologue = tcg_init_ctx.code_gen_prologue;
+
+        perf_report_code_name(prologue,
+                              (uint8_t *)tcg_init_ctx.code_gen_buffer -
+                              prologue, "qemu TCG prologue", map_only);
+        prologue_reported = true;
+    }
+
+    symbol = lookup_symbol(pc);
+    if (*symbol) {
+        name = g_strdup_printf("%s [guest 0x%" PRIx64 "]", symbol, pc);
+    } else {
+        name = g_strdup_printf("guest 0x%" PRIx64, pc);
+    }
+    perf_report_code_name(start, size, name, map_only);
+    g_free(name);
+}
+
+void perf_report_code(uint64_t pc, const void *start, size_t size)
+{
+    if (perfmap || jitdump) {
+        perf_report_tb_code(pc, start, size, false);
+    }
+}
+
+/* Called with tb_lock held.  */
+void perf_report_flush(void)
+{
+    if (perfmap) {
+        fflush(perfmap);
+        if (ftruncate(fileno(perfmap), 0) == 0) {
+            rewind(perfmap);
+        }
+        prologue_reported = false;
+    }
+}
+
+static gboolean perf_report_tb_iter(gpointer key, gpointer value,
+                                    gpointer data)
+{
+    TranslationBlock *tb = value;
+    bool *map_only = data;
+
+    perf_report_tb_code(tb->pc, tb->tc.ptr, tb->tc.size, *map_only);
+    return false;
+}
+
+/* Called with tb_lock held, after TBs have been removed from tb_tree.
+ * Their host code will be reused, so the map is rewritten with the TBs
+ * that remain.  The jitdump needs nothing: the code loaded later at the
+ * same address supersedes the old one from its timestamp on.
+ */
+void perf_report_retire(void)
+{
+    bool map_only = true;
+
+    if (perfmap) {
+        perf_report_flush();
+        g_tree_foreach(tb_ctx.tb_tree, perf_report_tb_iter, &map_only);
+    }
+}
+
+/* Called in the child, which only has the thread that forked.
+ * Every record was flushed as it was written, so closing the streams
+ * inherited from the parent writes nothing to its files.
+ */
+void perf_fork_child(void)
+{
+    bool map_only = false;
+
+    if (perfmap) {
+        fclose(perfmap);
+        perf_open_perfmap();
+    }
+    if (jitdump) {
+        fclose(jitdump);
+        munmap(jitdump_marker, jitdump_marker_size);
+        jitdump_marker = NULL;
+        jitdump_code_index = 0;
+        perf_open_jitdump();
+    }
+    perf_pid = getpid();
+    prologue_reported = false;
+    g_tree_foreach(tb_ctx.tb_tree, perf_report_tb_iter, &map_only);
+}
+
+void perf_exit(void)
+{
+    /* A child that did not go through perf_fork_child, for example a
+     * helper forked by the system emulator, must not close the files of
+     * its parent.
+     */
+    if (getpid() != perf_pid) {
+        return;
+    }
+    if (perfmap) {
+        fclose(perfmap);
+        perfmap = NULL;
+    }
+    if (jitdump) {
+        struct jr_prefix close_rec = {
+            .id = JIT_CODE_CLOSE,
+            .total_size = sizeof(close_rec),
+            .timestamp = jitdump_timestamp(),
+        };
+
+        fwrite(&close_rec, sizeof(close_rec), 1, jitdump);
+        fclose(jitdump);
+        jitdump = NULL;
+        munmap(jitdump_marker, jitdump_marker_size);
+        jitdump_marker = NULL;
+    }
+}
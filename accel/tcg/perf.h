@@ -0,0 +1,71 @@
+/*
+ * Linux perf perf-<pid>.map and jit-<pid>.dump integration.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+#ifndef ACCEL_TCG_PERF_H
+#define ACCEL_TCG_PERF_H
+
+#ifdef CONFIG_LINUX
+
+/* Start writing /tmp/perf-<pid>.map.  */
+void perf_enable_perfmap(void);
+
+/* Start writing ./jit-<pid>.dump, for use with "perf inject --jit".  */
+void perf_enable_jitdump(void);
+
+/* Describe the host code of a TB starting at guest address PC.  */
+void perf_report_code(uint64_t pc, const void *start, size_t size);
+
+/* The code cache has been flushed, forget the TBs reported so far.  */
+void perf_report_flush(void);
+
+/* Some TBs have been removed from tb_tree, forget them.  */
+void perf_report_retire(void);
+
+/* In a child created by fork(), leave the files of the parent alone and
+ * start the files of the child with the TBs inherited from the parent.
+ */
+void perf_fork_child(void);
+
+void perf_exit(void);
+
+#else
+
+#include "qemu/error-report.h"
+
+static inline void perf_enable_perfmap(void)
+{
+    warn_report("perfmap is only supported on Linux hosts");
+}
+
+static inline void perf_enable_jitdump(void)
+{
+    warn_report("jitdump is only supported on Linux hosts");
+}
+
+static inline void perf_report_code(uint64_t pc, const void *start,
+                                    size_t size)
+{
+}
+
+static inline void perf_report_flush(void)
+{
+}
+
+static inline void perf_report_retire(void)
+{
+}
+
+static inline void perf_fork_child(void)
+{
+}
+
+static inline void perf_exit(void)
+{
+}
+
+#endif
+
+#endif
@@ -0,0 +1,601 @@
+/*
+ * Persistent translation block cache for user-mode emulation.
+ *
+ * Short-lived processes spend most of their time translating the same
+ * program and library text as the previous run.  With -tb-cache, the
+ * host code of the TBs translated from executable file mappings is
+ * appended to one cache file per guest file, and loaded back instead of
+ * translating when a later run reaches the same TB.
+ *
+ * A cache file is named after a digest of the identity of the guest file
+ * (device, inode, size and modification time) and of everything else the
+ * generated code depends on: the QEMU executable, the host CPU features
+ * used by the backend, guest_base if the code embeds it, and the CPU
+ * model.  The code also embeds guest addresses, so records are looked up
+ * by pc, flags and cflags within the file.  Each record keeps a copy of
+ * the guest code it was translated from, which must match the current
+ * guest code for the record to be used.  From then on, the TB is
+ * protected like any other by the page protection of linux-user.
+ *
+ * The cache holds host code that QEMU runs, so the directory and the
+ * files must belong to the effective user and must not be writable by
+ * anyone else; they are created with mode 0700 and 0600.
+ *
+ * The backend keeps the saved code position independent, except for
+ * 32-bit pc-relative references to QEMU itself and to the prologue, which
+ * it records as relocations; see tcg_cache_reloc().  The translator must
+ * not embed host addresses in the code, which targets declare with
+ * TARGET_SUPPORTS_TB_CACHE.
+ *
+ * Records are appended with a single write(), so that concurrent QEMU
+ * processes can share a cache directory.  A reader stops at the first
+ * record that is truncated or does not match its checksum.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu-common.h"
+#include "qemu-version.h"
+#include "cpu.h"
+#include "exec/exec-all.h"
+#include "exec/cpu_ldst.h"
+#include "qemu/crc32c.h"
+#include "qemu/error-report.h"
+#include "qom/object.h"
+#include "tcg.h"
+#include "tb-cache.h"
+
+#if defined(TARGET_SUPPORTS_TB_CACHE) && TCG_TARGET_HAS_tb_cache && \
+    TCG_TARGET_HAS_direct_jump
+#define TB_CACHE_SUPPORTED 1
+#else
+#define TB_CACHE_SUPPORTED 0
+#endif
+
+#define TB_CACHE_MAGIC   0x43425451 /* "QTBC" */
+#define TB_CACHE_VERSION 2
+
+/* Stop appending to a cache file beyond this size.  */
+#define TB_CACHE_MAX_FILE_SIZE (64 * 1024 * 1024)
+
+typedef struct TBCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+} TBCacheHeader;
+
+typedef struct TBCacheKey {
+    uint64_t pc;
+    uint64_t cs_base;
+    uint32_t flags;
+    uint32_t cflags;
+} TBCacheKey;
+
+typedef struct TBCacheRecord {
+    TBCacheKey key;
+    uint32_t total_size;  /* a multiple of 8, so that records stay aligned */
+    uint32_t checksum;    /* crc32c of the record, this field excluded */
+    uint32_t trace_vcpu_dstate;
+    uint16_t size;
+    uint16_t icount;
+    uint16_t jmp_reset_offset[2];
+    uint32_t jmp_insn_offset[2];
+    uint32_t tb_offset;   /* from the TB to its code */
+    uint32_t code_size;
+    uint32_t search_size;
+    uint32_t nb_relocs;
+    /* followed by the relocations, the host code, the search data and
+       SIZE bytes of guest code */
+} TBCacheRecord;
+
+/* A guest file with executable mappings, and its cache file.  */
+typedef struct TBCacheFile {
+    char *id;           /* digest of the identity of the guest file */
+    char *path;         /* of the cache file */
+    bool loaded;
+    GHashTable *index;  /* TBCacheKey -> const TBCacheRecord */
+    int fd;             /* to append to the cache file, or -1 */
+    off_t size;         /* of the cache file as far as we know */
+    bool failed;        /* no more appending */
+} TBCacheFile;
+
+typedef struct TBCacheMapping {
+    target_ulong start;
+    target_ulong end;
+    TBCacheFile *file;
+} TBCacheMapping;
+
+static char *tb_cache_dir;
+static char *tb_cache_build;
+static bool tb_cache_enabled;
+static GHashTable *tb_cache_files;
+static GSList *tb_cache_mappings;
+
+void tb_cache_set_dir(const char *dir)
+{
+    g_free(tb_cache_dir);
+    tb_cache_dir = g_strdup(dir);
+}
+
+/* Whether a cache file or directory can only have been written by us.  */
+static bool tb_cache_stat_trusted(const struct stat *st)
+{
+    return st->st_uid == geteuid() && !(st->st_mode & (S_IWGRP | S_IWOTH));
+}
+
+void tb_cache_init(CPUState *cpu)
+{
+    struct {
+        uint64_t dev, ino, size, mtime, mtime_nsec;
+        TCGCacheHost host;
+        int32_t singlestep;
+        int32_t icache_linesize;
+    } build;
+    GChecksum *cs;
+    struct stat st;
+
+    if (!tb_cache_dir) {
+        return;
+    }
+    if (!TB_CACHE_SUPPORTED) {
+        warn_report("The TB cache is not supported for this guest and host");
+        goto fail;
+    }
+    if (g_mkdir_with_parents(tb_cache_dir, 0700) < 0 ||
+        stat(tb_cache_dir, &st) < 0) {
+        warn_report("Could not create %s: %s, proceeding without TB cache",
+                    tb_cache_dir, strerror(errno));
+        goto fail;
+    }
+    if (!S_ISDIR(st.st_mode) || !tb_cache_stat_trusted(&st)) {
+        warn_report("%s is not a directory owned by the user and writable "
+                    "only by them, proceeding without TB cache",
+                    tb_cache_dir);
+        goto fail;
+    }
+    if (stat("/proc/self/exe", &st) < 0) {
+        warn_report("Could not identify the QEMU executable: %s, "
+                    "proceeding without TB cache", strerror(errno));
+        goto fail;
+    }
+
+    memset(&build, 0, sizeof(build));
+    build.dev = st.st_dev;
+    build.ino = st.st_ino;
+    build.size = st.st_size;
+    build.mtime = st.st_mtim.tv_sec;
+    build.mtime_nsec = st.st_mtim.tv_nsec;
+    tcg_cache_host(&build.host);
+    build.singlestep = singlestep;
+    build.icache_linesize = qemu_icache_linesize;
+
+    cs = g_checksum_new(G_CHECKSUM_SHA256);
+    g_checksum_update(cs, (const guchar *)&build, sizeof(build));
+    /* The feature flags follow from the CPU model.  */
+    g_checksum_update(cs, (const guchar *)object_get_typename(OBJECT(cpu)),
+                      -1);
+    g_checksum_update(cs, (const guchar *)QEMU_VERSION, -1);
+    tb_cache_build = g_strdup(g_checksum_get_string(cs));
+    g_checksum_free(cs);
+
+    tb_cache_enabled = true;
+    return;
+
+fail:
+    g_free(tb_cache_dir);
+    tb_cache_dir = NULL;
+}
+
+static guint tb_cache_key_hash(gconstpointer p)
+{
+    const TBCacheKey *k = p;
+    uint64_t h = k->pc * 0x9e3779b97f4a7c15ULL;
+
+    h ^= k->cs_base ^ k->flags ^ ((uint64_t)k->cflags << 32);
+    return h ^ (h >> 32);
+}
+
+static gboolean tb_cache_key_equal(gconstpointer a, gconstpointer b)
+{
+    return !memcmp(a, b, sizeof(TBCacheKey));
+}
+
+static uint32_t tb_cache_checksum(const TBCacheRecord *rec)
+{
+    const uint8_t *p = (const uint8_t *)rec;
+    size_t ofs = offsetof(TBCacheRecord, checksum);
+    uint32_t crc;
+
+    crc = crc32c(0xffffffff, p, ofs);
+    ofs += sizeof(rec->checksum);
+    return crc32c(crc, p + ofs, rec->total_size - ofs);
+}
+
+static bool tb_cache_record_valid(const TBCacheRecord *rec, size_t avail)
+{
+    size_t size;
+
+    if (avail < sizeof(*rec) || rec->total_size < sizeof(*rec) ||
+        rec->total_size > avail || rec->total_size % 8 ||
+        rec->nb_relocs > TCG_MAX_CACHE_RELOCS) {
+        return false;
+    }
+    size = sizeof(*rec) + rec->nb_relocs * sizeof(TCGCacheReloc);
+    size += (size_t)rec->code_size + rec->search_size + rec->size;
+    if (size > rec->total_size) {
+        return false;
+    }
+    return tb_cache_checksum(rec) == rec->checksum;
+}
+
+static const char *tb_cache_file_path(TBCacheFile *f)
+{
+    if (!f->path) {
+        GChecksum *cs = g_checksum_new(G_CHECKSUM_SHA256);
+
+        g_checksum_update(cs, (const guchar *)tb_cache_build, -1);
+        g_checksum_update(cs, (const guchar *)f->id, -1);
+        f->path = g_strdup_printf("%s/%s.tbc", tb_cache_dir,
+                                  g_checksum_get_string(cs));
+        g_checksum_free(cs);
+    }
+    return f->path;
+}
+
+/* Read the index of a cache file, the first time one of its TBs is
+ * needed.  The records stay mapped for as long as the process lives.
+ */
+static void tb_cache_file_load(TBCacheFile *f)
+{
+    const TBCacheHeader *hdr;
+    struct stat st;
+    uint8_t *data;
+    size_t ofs;
+    int fd;
+
+    if (f->loaded) {
+        return;
+    }
+    f->loaded = true;
+    f->index = g_hash_table_new(tb_cache_key_hash, tb_cache_key_equal);
+
+    fd = open(tb_cache_file_path(f), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0) {
+        return;
+    }
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+        st.st_size < sizeof(*hdr)) {
+        close(fd);
+        return;
+    }
+    if (!tb_cache_stat_trusted(&st)) {
+        warn_report("Ignoring %s, which others could have written",
+                    f->path);
+        close(fd);
+        return;
+    }
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return;
+    }
+
+    hdr = (const TBCacheHeader *)data;
+    if (hdr->magic != TB_CACHE_MAGIC || hdr->version != TB_CACHE_VERSION) {
+        munmap(data, st.st_size);
+        return;
+    }
+
+    ofs = QEMU_ALIGN_UP(sizeof(*hdr), 8);
+    while (ofs < st.st_size) {
+        const TBCacheRecord *rec = (const TBCacheRecord *)(data + ofs);
+
+        if (!tb_cache_record_valid(rec, st.st_size - ofs)) {
+            break;
+        }
+        if (!g_hash_table_contains(f->index, &rec->key)) {
+            g_hash_table_insert(f->index, (gpointer)&rec->key, (gpointer)rec);
+        }
+        ofs += rec->total_size;
+    }
+}
+
+/* Open the cache file for appending, creating it if needed.  */
+static bool tb_cache_file_open(TBCacheFile *f)
+{
+    const char *path;
+    struct stat st;
+    int fd;
+
+    if (f->fd >= 0) {
+        return true;
+    }
+    if (f->failed) {
+        return false;
+    }
+
+    path = tb_cache_file_path(f);
+    fd = open(path, O_WRONLY | O_APPEND | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0 && errno == ENOENT) {
+        /* Publish the file with its header already in place, so that
+         * other processes never append to a file without one.
+         */
+        TBCacheHeader hdr = { TB_CACHE_MAGIC, TB_CACHE_VERSION };
+        uint8_t buf[QEMU_ALIGN_UP(sizeof(hdr), 8)] = { 0 };
+        char *tmp = g_strdup_printf("%s.%d", path, getpid());
+        int tmp_fd;
+
+        /* Left over by a process that had our pid and died.  */
+        unlink(tmp);
+        tmp_fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+
+        if (tmp_fd >= 0) {
+            memcpy(buf, &hdr, sizeof(hdr));
+            if (write(tmp_fd, buf, sizeof(buf)) == sizeof(buf)) {
+                /* Whoever links first wins; their header is as good.  */
+                if (link(tmp, path) < 0 && errno != EEXIST) {
+                    warn_report("Could not create %s: %s", path,
+                                strerror(errno));
+                }
+            }
+            close(tmp_fd);
+            unlink(tmp);
+        }
+        g_free(tmp);
+        fd = open(path, O_WRONLY | O_APPEND | O_CLOEXEC | O_NOFOLLOW);
+    }
+    if (fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+        !tb_cache_stat_trusted(&st)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        f->failed = true;
+        return false;
+    }
+    f->fd = fd;
+    f->size = st.st_size;
+    return true;
+}
+
+static TBCacheFile *tb_cache_file_get(const struct stat *st)
+{
+    struct {
+        uint64_t dev, ino, size, mtime, mtime_nsec;
+    } id;
+    TBCacheFile *f;
+    char *digest;
+
+    memset(&id, 0, sizeof(id));
+    id.dev = st->st_dev;
+    id.ino = st->st_ino;
+    id.size = st->st_size;
+    id.mtime = st->st_mtim.tv_sec;
+    id.mtime_nsec = st->st_mtim.tv_nsec;
+    digest = g_compute_checksum_for_data(G_CHECKSUM_SHA256,
+                                         (const guchar *)&id, sizeof(id));
+
+    if (!tb_cache_files) {
+        tb_cache_files = g_hash_table_new(g_str_hash, g_str_equal);
+    }
+    f = g_hash_table_lookup(tb_cache_files, digest);
+    if (f) {
+        g_free(digest);
+        return f;
+    }
+    f = g_new0(TBCacheFile, 1);
+    f->id = digest;
+    f->fd = -1;
+    g_hash_table_insert(tb_cache_files, f->id, f);
+    return f;
+}
+
+void tb_cache_unmap(target_ulong start, target_ulong len)
+{
+    target_ulong end = start + len;
+    GSList *l, *next;
+
+    for (l = tb_cache_mappings; l; l = next) {
+        TBCacheMapping *m = l->data;
+
+        next = l->next;
+        if (m->end <= start || m->start >= end) {
+            continue;
+        }
+        if (m->start < start && m->end > end) {
+            TBCacheMapping *tail = g_new(TBCacheMapping, 1);
+
+            tail->start = end;
+            tail->end = m->end;
+            tail->file = m->file;
+            tb_cache_mappings = g_slist_prepend(tb_cache_mappings, tail);
+            m->end = start;
+        } else if (m->start < start) {
+            m->end = start;
+        } else if (m->end > end) {
+            m->start = end;
+        } else {
+            tb_cache_mappings = g_slist_delete_link(tb_cache_mappings, l);
+            g_free(m);
+        }
+    }
+}
+
+void tb_cache_map(target_ulong start, target_ulong len, int prot, int fd)
+{
+    TBCacheMapping *m;
+    struct stat st;
+
+    if (!tb_cache_dir) {
+        return;
+    }
+    tb_cache_unmap(start, len);
+    if (fd < 0 || !(prot & PROT_EXEC) || fstat(fd, &st) < 0 ||
+        !S_ISREG(st.st_mode)) {
+        return;
+    }
+
+    m = g_new(TBCacheMapping, 1);
+    m->start = start;
+    m->end = start + len;
+    m->file = tb_cache_file_get(&st);
+    tb_cache_mappings = g_slist_prepend(tb_cache_mappings, m);
+}
+
+static TBCacheMapping *tb_cache_mapping_at(target_ulong pc)
+{
+    GSList *l;
+
+    for (l = tb_cache_mappings; l; l = l->next) {
+        TBCacheMapping *m = l->data;
+
+        if (pc >= m->start && pc < m->end) {
+            return m;
+        }
+    }
+    return NULL;
+}
+
+static TBCacheMapping *tb_cache_find(CPUState *cpu, TranslationBlock *tb)
+{
+    /* The execution counter embeds the address of the TB.  */
+    if (!tb_cache_enabled || (tb->cflags & CF_NOCACHE) ||
+        cpu->singlestep_enabled || tb_profile_enabled ||
+        (tb_hot_threshold && !(tb->cflags & CF_HOT))) {
+        return NULL;
+    }
+    return tb_cache_mapping_at(tb->pc);
+}
+
+bool tb_cache_load(CPUState *cpu, TranslationBlock *tb, int *search_size)
+{
+    TBCacheMapping *m = tb_cache_find(cpu, tb);
+    const TBCacheRecord *rec;
+    const TCGCacheReloc *relocs;
+    const uint8_t *p, *guest;
+    void *code = tb->tc.ptr;
+    TBCacheKey key;
+
+    if (!m) {
+        return false;
+    }
+    tb_cache_file_load(m->file);
+
+    memset(&key, 0, sizeof(key));
+    key.pc = tb->pc;
+    key.cs_base = tb->cs_base;
+    key.flags = tb->flags;
+    key.cflags = tb->cflags;
+    rec = g_hash_table_lookup(m->file->index, &key);
+    if (!rec) {
+        return false;
+    }
+
+    if (tb->pc + rec->size > m->end ||
+        rec->trace_vcpu_dstate != tb->trace_vcpu_dstate ||
+        rec->tb_offset != (uintptr_t)code - (uintptr_t)tb ||
+        code + rec->code_size + rec->search_size >
+        tcg_ctx->code_gen_highwater) {
+        return false;
+    }
+    p = (const uint8_t *)(rec + 1);
+    relocs = (const TCGCacheReloc *)p;
+    p += rec->nb_relocs * sizeof(TCGCacheReloc);
+    guest = p + rec->code_size + rec->search_size;
+
+    /* The guest code may have changed since it was saved.  */
+    if (page_check_range(tb->pc, rec->size, PAGE_READ) < 0 ||
+        memcmp(g2h(tb->pc), guest, rec->size)) {
+        return false;
+    }
+
+    memcpy(code, p, rec->code_size + rec->search_size);
+    if (!tcg_cache_relocate(code, relocs, rec->nb_relocs)) {
+        return false;
+    }
+    flush_icache_range((uintptr_t)code, (uintptr_t)code + rec->code_size);
+
+    tb->size = rec->size;
+    tb->icount = rec->icount;
+    tb->tc.size = rec->code_size;
+    tb->jmp_reset_offset[0] = rec->jmp_reset_offset[0];
+    tb->jmp_reset_offset[1] = rec->jmp_reset_offset[1];
+    tb->jmp_target_arg[0] = rec->jmp_insn_offset[0];
+    tb->jmp_target_arg[1] = rec->jmp_insn_offset[1];
+    *search_size = rec->search_size;
+    return true;
+}
+
+/* Have the backend record what tb_cache_save needs while generating
+ * the code of TB.  Call after tcg_func_start.
+ */
+void tb_cache_record(CPUState *cpu, TranslationBlock *tb)
+{
+    tcg_ctx->cache_record = tb_cache_find(cpu, tb) != NULL;
+}
+
+void tb_cache_save(TranslationBlock *tb, int search_size)
+{
+    TCGContext *s = tcg_ctx;
+    TBCacheMapping *m;
+    TBCacheRecord *rec;
+    TBCacheFile *f;
+    size_t relocs_size, size;
+    uint8_t *p;
+    ssize_t ret;
+
+    if (!s->cache_record || s->cache_unsafe) {
+        return;
+    }
+    m = tb_cache_mapping_at(tb->pc);
+    if (!m || tb->pc + tb->size > m->end) {
+        return;
+    }
+    f = m->file;
+    if (!tb_cache_file_open(f) || f->size >= TB_CACHE_MAX_FILE_SIZE) {
+        return;
+    }
+
+    relocs_size = s->nb_cache_relocs * sizeof(TCGCacheReloc);
+    size = sizeof(*rec) + relocs_size + tb->tc.size + search_size + tb->size;
+    size = QEMU_ALIGN_UP(size, 8);
+    rec = g_malloc0(size);
+
+    rec->key.pc = tb->pc;
+    rec->key.cs_base = tb->cs_base;
+    rec->key.flags = tb->flags;
+    rec->key.cflags = tb->cflags;
+    rec->total_size = size;
+    rec->trace_vcpu_dstate = tb->trace_vcpu_dstate;
+    rec->size = tb->size;
+    rec->icount = tb->icount;
+    rec->jmp_reset_offset[0] = tb->jmp_reset_offset[0];
+    rec->jmp_reset_offset[1] = tb->jmp_reset_offset[1];
+    rec->jmp_insn_offset[0] = tb->jmp_target_arg[0];
+    rec->jmp_insn_offset[1] = tb->jmp_target_arg[1];
+    rec->tb_offset = (uintptr_t)tb->tc.ptr - (uintptr_t)tb;
+    rec->code_size = tb->tc.size;
+    rec->search_size = search_size;
+    rec->nb_relocs = s->nb_cache_relocs;
+
+    p = (uint8_t *)(rec + 1);
+    memcpy(p, s->cache_relocs, relocs_size);
+    p += relocs_size;
+    memcpy(p, tb->tc.ptr, tb->tc.size + search_size);
+    p += tb->tc.size + search_size;
+    memcpy(p, g2h(tb->pc), tb->size);
+    rec->checksum = tb_cache_checksum(rec);
+
+    ret = write(f->fd, rec, size);
+    if (ret != size) {
+        /* A short write leaves a bad record, which ends the file for
+         * readers; don't add more after it.
+         */
+        close(f->fd);
+        f->fd = -1;
+        f->failed = true;
+    } else {
+        f->size += size;
+    }
+    g_free(rec);
+}
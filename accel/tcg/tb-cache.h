@@ -0,0 +1,43 @@
+/*
+ * Persistent translation block cache for user-mode emulation.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+#ifndef ACCEL_TCG_TB_CACHE_H
+#define ACCEL_TCG_TB_CACHE_H
+
+#ifdef CONFIG_USER_ONLY
+/* Keep the cache in DIR.  Call before the guest program is loaded.  */
+void tb_cache_set_dir(const char *dir);
+
+/* Start using the cache, once guest_base is fixed and CPU created.  */
+void tb_cache_init(CPUState *cpu);
+
+/* Track the executable file mappings of the guest.
+ * Called with mmap_lock held.
+ */
+void tb_cache_map(target_ulong start, target_ulong len, int prot, int fd);
+void tb_cache_unmap(target_ulong start, target_ulong len);
+
+/* Called from tb_gen_code, with tb_lock and mmap_lock held.  */
+bool tb_cache_load(CPUState *cpu, TranslationBlock *tb, int *search_size);
+void tb_cache_record(CPUState *cpu, TranslationBlock *tb);
+void tb_cache_save(TranslationBlock *tb, int search_size);
+#else
+static inline bool tb_cache_load(CPUState *cpu, TranslationBlock *tb,
+                                 int *search_size)
+{
+    return false;
+}
+
+static inline void tb_cache_record(CPUState *cpu, TranslationBlock *tb)
+{
+}
+
+static inline void tb_cache_save(TranslationBlock *tb, int search_size)
+{
+}
+#endif
+
+#endif
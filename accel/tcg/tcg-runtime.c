@@ -166,3 +166,8 @@ void HELPER(exit_atomic)(CPUArchState *env)
 {
     cpu_loop_exit_atomic(ENV_GET_CPU(env), GETPC());
 }
+
+void HELPER(tb_hot)(void *tb)
+{
+    tb_mark_hot(tb);
+}
@@ -53,8 +53,11 @@
 #include "exec/cputlb.h"
 #include "exec/tb-hash.h"
 #include "translate-all.h"
+#include "perf.h"
+#include "tb-cache.h"
 #include "qemu/bitmap.h"
 #include "qemu/error-report.h"
+#include "qemu/range-map.h"
 #include "qemu/timer.h"
 #include "qemu/main-loop.h"
 #include "exec/log.h"
@@ -157,6 +160,8 @@ TCGContext tcg_init_ctx;
 __thread TCGContext *tcg_ctx;
 TBContext tb_ctx;
 bool parallel_cpus;
+bool tb_profile_enabled;
+unsigned tb_hot_threshold;
 
 /* translation block context */
 static __thread int have_tb_lock;
@@ -512,6 +517,33 @@ static inline PageDesc *page_find(tb_page_addr_t index)
     return page_find_alloc(index, 0);
 }
 
+#ifdef CONFIG_USER_ONLY
+/* A copy of PageDesc.flags, as runs of pages with the same flags, so
+ * that searches over ranges of pages need not walk the page table one
+ * page at a time.  Updated with PageDesc.flags, under mmap_lock.
+ */
+static RangeMap *page_flags_map;
+
+static RangeMap *page_flags_map_get(void)
+{
+    if (!page_flags_map) {
+        page_flags_map = range_map_new(
+            (uint64_t)1 << (L1_MAP_ADDR_SPACE_BITS - TARGET_PAGE_BITS));
+    }
+    return page_flags_map;
+}
+
+/* Record FLAGS for the LEN bytes of pages at START.  */
+static void page_flags_map_set(target_ulong start, target_ulong len,
+                               int flags)
+{
+    uint64_t index = start >> TARGET_PAGE_BITS;
+
+    range_map_set(page_flags_map_get(), index,
+                  index + (len >> TARGET_PAGE_BITS), flags);
+}
+#endif
+
 #if defined(CONFIG_USER_ONLY)
 /* Currently it is not recommended to allocate big chunks of data in
    user mode. It will change when a dedicated libc will be used.  */
@@ -829,14 +861,131 @@ static TranslationBlock *tb_alloc(target_ulong pc)
     return tb;
 }
 
+/* Execution counts of the TBs that are gone, keyed by guest PC, so that
+ * a profile survives tb_flush and retranslation.  Protected by tb_lock.
+ */
+static GHashTable *tb_profile_counts;
+
+static void tb_profile_account(GHashTable *counts, target_ulong pc,
+                               uint64_t count)
+{
+    uint64_t key = pc;
+    TBProfileEntry *e = g_hash_table_lookup(counts, &key);
+
+    if (!e) {
+        e = g_new0(TBProfileEntry, 1);
+        e->pc = pc;
+        g_hash_table_insert(counts, &e->pc, e);
+    }
+    e->count += count;
+}
+
+static GHashTable *tb_profile_counts_new(void)
+{
+    return g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, g_free);
+}
+
+/* Called with tb_lock held.  */
+static void tb_profile_retire(TranslationBlock *tb)
+{
+    uint64_t count = atomic_read(&tb->exec_count);
+
+    /* Without the profiler, the count is only there for tb_mark_hot.  */
+    if (count && tb_profile_enabled) {
+        if (!tb_profile_counts) {
+            tb_profile_counts = tb_profile_counts_new();
+        }
+        tb_profile_account(tb_profile_counts, tb->pc, count);
+    }
+}
+
+static gboolean tb_profile_retire_iter(gpointer key, gpointer value,
+                                       gpointer data)
+{
+    tb_profile_retire(value);
+    return false;
+}
+
 /* Called with tb_lock held.  */
 void tb_remove(TranslationBlock *tb)
 {
     assert_tb_locked();
 
+    tb_profile_retire(tb);
     g_tree_remove(tb_ctx.tb_tree, &tb->tc);
 }
 
+/* The guest code that was entered tb_hot_threshold times, and is
+ * translated with CF_HOT from then on.  Cleared by tb_flush so that it
+ * does not grow without bounds.  Protected by tb_lock.
+ */
+typedef struct TBHotKey {
+    target_ulong pc;
+    target_ulong cs_base;
+    uint32_t flags;
+} TBHotKey;
+
+static GHashTable *tb_hot;
+
+static guint tb_hot_hash(gconstpointer p)
+{
+    const TBHotKey *k = p;
+
+    return tb_hash_func(0, k->pc ^ k->cs_base, k->flags, 0, 0);
+}
+
+static gboolean tb_hot_equal(gconstpointer a, gconstpointer b)
+{
+    return !memcmp(a, b, sizeof(TBHotKey));
+}
+
+static void tb_hot_key_init(TBHotKey *k, target_ulong pc,
+                            target_ulong cs_base, uint32_t flags)
+{
+    memset(k, 0, sizeof(*k));
+    k->pc = pc;
+    k->cs_base = cs_base;
+    k->flags = flags;
+}
+
+static bool tb_is_hot(target_ulong pc, target_ulong cs_base, uint32_t flags)
+{
+    TBHotKey k;
+
+    if (!tb_hot) {
+        return false;
+    }
+    tb_hot_key_init(&k, pc, cs_base, flags);
+    return g_hash_table_contains(tb_hot, &k);
+}
+
+/* Called by the code of TB when it reaches tb_hot_threshold.  Once TB
+ * is invalidated, the next lookup of its PC misses and translates it
+ * again, as a superblock.  TB itself runs to its end, but it is no
+ * longer chained to.
+ */
+void tb_mark_hot(TranslationBlock *tb)
+{
+    tb_lock();
+    if (!(tb->cflags & CF_INVALID)) {
+        TBHotKey *k = g_new(TBHotKey, 1);
+
+        tb_hot_key_init(k, tb->pc, tb->cs_base, tb->flags);
+        if (!tb_hot) {
+            tb_hot = g_hash_table_new_full(tb_hot_hash, tb_hot_equal,
+                                           g_free, NULL);
+        }
+        g_hash_table_add(tb_hot, k);
+        tb_phys_invalidate(tb, -1);
+    }
+    tb_unlock();
+}
+
+void tb_hot_set_threshold(unsigned threshold)
+{
+    tb_hot_threshold = threshold;
+}
+
 static inline void invalidate_page_bitmap(PageDesc *p)
 {
 #ifdef CONFIG_SOFTMMU
@@ -913,6 +1062,12 @@ static void do_tb_flush(CPUState *cpu, run_on_cpu_data tb_flush_count)
         cpu_tb_jmp_cache_clear(cpu);
     }
 
+    g_tree_foreach(tb_ctx.tb_tree, tb_profile_retire_iter, NULL);
+    perf_report_flush();
+    if (tb_hot) {
+        g_hash_table_remove_all(tb_hot);
+    }
+
     /* Increment the refcount first so that destroy acts as a reset */
     g_tree_ref(tb_ctx.tb_tree);
     g_tree_destroy(tb_ctx.tb_tree);
@@ -938,6 +1093,96 @@ void tb_flush(CPUState *cpu)
     }
 }
 
+/* Changes whenever the code cache is flushed or a region evicted.  */
+static unsigned tb_reclaim_count(void)
+{
+    return atomic_mb_read(&tb_ctx.tb_flush_count) +
+           atomic_mb_read(&tb_ctx.tb_evict_count);
+}
+
+struct tb_region_range {
+    const void *start;
+    const void *end;
+    GPtrArray *tbs;
+};
+
+static gboolean tb_region_collect_iter(gpointer key, gpointer value,
+                                       gpointer data)
+{
+    const struct tb_tc *tc = key;
+    struct tb_region_range *r = data;
+
+    if (tc->ptr >= r->end) {
+        return true;
+    }
+    if (tc->ptr >= r->start) {
+        g_ptr_array_add(r->tbs, value);
+    }
+    return false;
+}
+
+/* evict the translation blocks of the oldest code region */
+static void do_tb_evict_region(CPUState *cpu, run_on_cpu_data reclaim_count)
+{
+    struct tb_region_range r;
+    size_t curr_region;
+    void *start, *end;
+    guint i;
+
+    tb_lock();
+
+    /* If space has already been reclaimed on request of another CPU,
+     * just retry.
+     */
+    if (tb_reclaim_count() != reclaim_count.host_int) {
+        goto done;
+    }
+
+    if (!tcg_region_victim(&curr_region, &start, &end)) {
+        /* Every region is in use by a TCG thread, start over.  */
+        tb_unlock();
+        do_tb_flush(cpu, RUN_ON_CPU_HOST_INT(tb_ctx.tb_flush_count));
+        return;
+    }
+
+    /* tb_tree is sorted by host address, and a TB lies in the same
+     * region as its code.
+     */
+    r.start = start;
+    r.end = end;
+    r.tbs = g_ptr_array_new();
+    g_tree_foreach(tb_ctx.tb_tree, tb_region_collect_iter, &r);
+
+    if (DEBUG_TB_FLUSH_GATE) {
+        printf("qemu: evict region=%zu nb_tbs=%u\n", curr_region, r.tbs->len);
+    }
+
+    for (i = 0; i < r.tbs->len; i++) {
+        TranslationBlock *tb = g_ptr_array_index(r.tbs, i);
+
+        /* This also unlinks the jumps from TBs in other regions.  */
+        tb_phys_invalidate(tb, -1);
+        tb_remove(tb);
+    }
+    g_ptr_array_free(r.tbs, true);
+    perf_report_retire();
+
+    tcg_region_release(curr_region);
+    atomic_mb_set(&tb_ctx.tb_evict_count, tb_ctx.tb_evict_count + 1);
+
+done:
+    tb_unlock();
+}
+
+/* Make room in the code cache, evicting the oldest region if possible
+ * and flushing everything otherwise.
+ */
+static void tb_reclaim(CPUState *cpu)
+{
+    async_safe_run_on_cpu(cpu, do_tb_evict_region,
+                          RUN_ON_CPU_HOST_INT(tb_reclaim_count()));
+}
+
 /*
  * Formerly ifdef DEBUG_TB_CHECK. These debug functions are user-mode-only,
  * so in order to prevent bit rot we compile them unconditionally in user-mode,
@@ -1192,6 +1437,7 @@ static inline void tb_alloc_page(TranslationBlock *tb,
             }
             prot |= p2->flags;
             p2->flags &= ~PAGE_WRITE;
+            page_flags_map_set(addr, TARGET_PAGE_SIZE, p2->flags);
           }
         mprotect(g2h(page_addr), qemu_host_page_size,
                  (prot & PAGE_BITS) & ~PAGE_WRITE);
@@ -1260,11 +1506,16 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
 
     phys_pc = get_page_addr_code(env, pc);
 
+    if (tb_hot_threshold && !(cflags & (CF_NOCACHE | CF_COUNT_MASK)) &&
+        tb_is_hot(pc, cs_base, flags)) {
+        cflags |= CF_HOT;
+    }
+
  buffer_overflow:
     tb = tb_alloc(pc);
     if (unlikely(!tb)) {
-        /* flush must be done */
-        tb_flush(cpu);
+        /* eviction or flush must be done */
+        tb_reclaim(cpu);
         mmap_unlock();
         /* Make the execution loop process the flush as soon as possible.  */
         cpu->exception_index = EXCP_INTERRUPT;
@@ -1278,8 +1529,14 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     tb->flags = flags;
     tb->cflags = cflags;
     tb->trace_vcpu_dstate = *cpu->trace_dstate;
+    tb->exec_count = 0;
     tcg_ctx->tb_cflags = cflags;
 
+    if (tb_cache_load(cpu, tb, &search_size)) {
+        gen_code_size = tb->tc.size;
+        goto cached;
+    }
+
 #ifdef CONFIG_PROFILER
     /* includes aborted translations because of exceptions */
     atomic_set(&prof->tb_count1, prof->tb_count1 + 1);
@@ -1287,6 +1544,7 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
 #endif
 
     tcg_func_start(tcg_ctx);
+    tb_cache_record(cpu, tb);
 
     tcg_ctx->cpu = ENV_GET_CPU(env);
     gen_intermediate_code(cpu, tb);
@@ -1326,6 +1584,7 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
         goto buffer_overflow;
     }
     tb->tc.size = gen_code_size;
+    tb_cache_save(tb, search_size);
 
 #ifdef CONFIG_PROFILER
     atomic_set(&prof->code_time, prof->code_time + profile_getclock() - ti);
@@ -1366,6 +1625,9 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     }
 #endif
 
+ cached:
+    perf_report_code(pc, gen_code_buf, gen_code_size);
+
     atomic_set(&tcg_ctx->code_gen_ptr, (void *)
         ROUND_UP((uintptr_t)gen_code_buf + gen_code_size + search_size,
                  CODE_GEN_ALIGN));
@@ -1918,8 +2180,13 @@ void dump_exec_info(FILE *f, fprintf_function cpu_fprintf)
     cpu_fprintf(f, "\nStatistics:\n");
     cpu_fprintf(f, "TB flush count      %u\n",
                 atomic_read(&tb_ctx.tb_flush_count));
+    cpu_fprintf(f, "TB evict count      %u\n",
+                atomic_read(&tb_ctx.tb_evict_count));
     cpu_fprintf(f, "TB invalidate count %d\n", tb_ctx.tb_phys_invalidate_count);
+    cpu_fprintf(f, "TB hot count        %u\n",
+                tb_hot ? g_hash_table_size(tb_hot) : 0);
     cpu_fprintf(f, "TLB flush count     %zu\n", tlb_flush_count());
+    dump_tlb_info(f, cpu_fprintf);
     tcg_dump_info(f, cpu_fprintf);
 
     tb_unlock();
@@ -1930,6 +2197,93 @@ void dump_opcount_info(FILE *f, fprintf_function cpu_fprintf)
     tcg_dump_op_count(f, cpu_fprintf);
 }
 
+/* Changing the setting only affects new translations, so start over.  */
+void tb_profile_set_enabled(bool enable)
+{
+    if (tb_profile_enabled != enable) {
+        atomic_set(&tb_profile_enabled, enable);
+        tb_flush(first_cpu);
+    }
+}
+
+static gboolean tb_profile_reset_iter(gpointer key, gpointer value,
+                                      gpointer data)
+{
+    TranslationBlock *tb = value;
+
+    atomic_set(&tb->exec_count, 0);
+    return false;
+}
+
+void tb_profile_reset(void)
+{
+    tb_lock();
+    if (tb_profile_counts) {
+        g_hash_table_remove_all(tb_profile_counts);
+    }
+    g_tree_foreach(tb_ctx.tb_tree, tb_profile_reset_iter, NULL);
+    tb_unlock();
+}
+
+static gboolean tb_profile_snapshot_iter(gpointer key, gpointer value,
+                                         gpointer data)
+{
+    TranslationBlock *tb = value;
+    uint64_t count = atomic_read(&tb->exec_count);
+
+    if (count) {
+        tb_profile_account(data, tb->pc, count);
+    }
+    return false;
+}
+
+static void tb_profile_copy(gpointer key, gpointer value, gpointer data)
+{
+    TBProfileEntry *e = value;
+
+    tb_profile_account(data, e->pc, e->count);
+}
+
+static gint tb_profile_cmp(gconstpointer ap, gconstpointer bp)
+{
+    const TBProfileEntry *a = ap;
+    const TBProfileEntry *b = bp;
+
+    if (a->count != b->count) {
+        return a->count > b->count ? -1 : 1;
+    }
+    return a->pc < b->pc ? -1 : a->pc > b->pc;
+}
+
+static void tb_profile_append(gpointer key, gpointer value, gpointer data)
+{
+    g_array_append_val((GArray *)data, *(TBProfileEntry *)value);
+}
+
+/* Return the execution counts summed per guest PC, hottest first.  The
+ * counts of all the translations of a PC are merged, including those
+ * retired by invalidation or tb_flush.
+ */
+GArray *tb_profile_snapshot(void)
+{
+    GHashTable *counts = tb_profile_counts_new();
+    GArray *entries;
+
+    tb_lock();
+    if (tb_profile_counts) {
+        g_hash_table_foreach(tb_profile_counts, tb_profile_copy, counts);
+    }
+    g_tree_foreach(tb_ctx.tb_tree, tb_profile_snapshot_iter, counts);
+    tb_unlock();
+
+    entries = g_array_sized_new(false, false, sizeof(TBProfileEntry),
+                                g_hash_table_size(counts));
+    g_hash_table_foreach(counts, tb_profile_append, entries);
+    g_hash_table_destroy(counts);
+    g_array_sort(entries, tb_profile_cmp);
+    return entries;
+}
+
 #else /* CONFIG_USER_ONLY */
 
 void cpu_interrupt(CPUState *cpu, int mask)
@@ -2099,13 +2453,14 @@ void page_set_flags(target_ulong start, target_ulong end, int flags)
         }
         p->flags = flags;
     }
+    page_flags_map_set(start, end - start, flags);
 }
 
 int page_check_range(target_ulong start, target_ulong len, int flags)
 {
-    PageDesc *p;
     target_ulong end;
     target_ulong addr;
+    int ret = 0;
 
     /* This function should never be called with addresses outside the
        guest address space.  If this assert fires, it probably indicates
@@ -2126,34 +2481,66 @@ int page_check_range(target_ulong start, target_ulong len, int flags)
     end = TARGET_PAGE_ALIGN(start + len);
     start = start & TARGET_PAGE_MASK;
 
-    for (addr = start, len = end - start;
-         len != 0;
-         len -= TARGET_PAGE_SIZE, addr += TARGET_PAGE_SIZE) {
-        p = page_find(addr >> TARGET_PAGE_BITS);
-        if (!p) {
-            return -1;
-        }
-        if (!(p->flags & PAGE_VALID)) {
-            return -1;
-        }
+    /* Check each run of pages with the same flags at once.  */
+    mmap_lock();
+    for (addr = start, len = end - start; len != 0; ) {
+        uint64_t run_end;
+        target_ulong run_len;
+        int page_flags;
 
-        if ((flags & PAGE_READ) && !(p->flags & PAGE_READ)) {
-            return -1;
+        page_flags = range_map_get(page_flags_map_get(),
+                                   addr >> TARGET_PAGE_BITS, NULL, &run_end);
+        run_len = MIN((run_end << TARGET_PAGE_BITS) - addr, (uint64_t)len);
+
+        if (!(page_flags & PAGE_VALID)) {
+            ret = -1;
+            break;
+        }
+        if ((flags & PAGE_READ) && !(page_flags & PAGE_READ)) {
+            ret = -1;
+            break;
         }
         if (flags & PAGE_WRITE) {
-            if (!(p->flags & PAGE_WRITE_ORG)) {
-                return -1;
+            if (!(page_flags & PAGE_WRITE_ORG)) {
+                ret = -1;
+                break;
             }
             /* unprotect the page if it was put read-only because it
-               contains translated code */
-            if (!(p->flags & PAGE_WRITE)) {
+               contains translated code, then look at its flags again */
+            if (!(page_flags & PAGE_WRITE)) {
                 if (!page_unprotect(addr, 0)) {
-                    return -1;
+                    ret = -1;
+                    break;
                 }
+                continue;
             }
         }
+        addr += run_len;
+        len -= run_len;
     }
-    return 0;
+    mmap_unlock();
+    return ret;
+}
+
+/* Return the highest multiple of ALIGN at which LEN bytes of pages are
+ * unmapped and end at or below END, or -1 if there is none.  Called
+ * with mmap_lock held.
+ */
+target_ulong page_find_range_empty_last(target_ulong end, target_ulong len,
+                                        target_ulong align)
+{
+    uint64_t index;
+
+    assert_memory_lock();
+    if (len == 0 ||
+        !range_map_find_free_last(page_flags_map_get(),
+                                  end >> TARGET_PAGE_BITS,
+                                  DIV_ROUND_UP(len, TARGET_PAGE_SIZE),
+                                  MAX(align >> TARGET_PAGE_BITS, 1),
+                                  &index)) {
+        return -1;
+    }
+    return index << TARGET_PAGE_BITS;
 }
 
 /* called from signal handler: invalidate the code and unprotect the
@@ -2192,6 +2579,7 @@ int page_unprotect(target_ulong address, uintptr_t pc)
             p = page_find(addr >> TARGET_PAGE_BITS);
             p->flags |= PAGE_WRITE;
             prot |= p->flags;
+            page_flags_map_set(addr, TARGET_PAGE_SIZE, p->flags);
 
             /* and since the content will be modified, we must invalidate
                the corresponding translated code. */
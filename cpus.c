@@ -47,6 +47,7 @@
 #include "qemu/bitmap.h"
 #include "qemu/seqlock.h"
 #include "tcg.h"
+#include "perf.h"
 #include "qapi-event.h"
 #include "hw/nmi.h"
 #include "sysemu/replay.h"
@@ -222,6 +223,14 @@ void qemu_tcg_configure(QemuOpts *opts, Error **errp)
     } else {
         mttcg_enabled = default_mttcg_enabled();
     }
+
+    if (qemu_opt_get_bool(opts, "perfmap", false)) {
+        perf_enable_perfmap();
+    }
+    if (qemu_opt_get_bool(opts, "jitdump", false)) {
+        perf_enable_jitdump();
+    }
+    tb_hot_set_threshold(qemu_opt_get_number(opts, "hot-threshold", 0));
 }
 
 /* The current number of executed instructions is based on what we
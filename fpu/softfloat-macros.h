@@ -200,6 +200,15 @@ static inline void
  shift128Right(
      uint64_t a0, uint64_t a1, int count, uint64_t *z0Ptr, uint64_t *z1Ptr)
 {
+#ifdef CONFIG_INT128
+    __uint128_t z = 0;
+
+    if (count < 128) {
+        z = (((__uint128_t)a0 << 64) | a1) >> count;
+    }
+    *z1Ptr = z;
+    *z0Ptr = z >> 64;
+#else
     uint64_t z0, z1;
     int8_t negCount = ( - count ) & 63;
 
@@ -217,7 +226,7 @@ static inline void
     }
     *z1Ptr = z1;
     *z0Ptr = z0;
-
+#endif
 }
 
 /*----------------------------------------------------------------------------
@@ -235,6 +244,20 @@ static inline void
  shift128RightJamming(
      uint64_t a0, uint64_t a1, int count, uint64_t *z0Ptr, uint64_t *z1Ptr)
 {
+#ifdef CONFIG_INT128
+    __uint128_t a = ((__uint128_t)a0 << 64) | a1;
+    __uint128_t z;
+
+    if (count == 0) {
+        z = a;
+    } else if (count < 128) {
+        z = (a >> count) | ((a << (128 - count)) != 0);
+    } else {
+        z = (a != 0);
+    }
+    *z1Ptr = z;
+    *z0Ptr = z >> 64;
+#else
     uint64_t z0, z1;
     int8_t negCount = ( - count ) & 63;
 
@@ -260,7 +283,7 @@ static inline void
     }
     *z1Ptr = z1;
     *z0Ptr = z0;
-
+#endif
 }
 
 /*----------------------------------------------------------------------------
@@ -344,11 +367,16 @@ static inline void
  shortShift128Left(
      uint64_t a0, uint64_t a1, int count, uint64_t *z0Ptr, uint64_t *z1Ptr)
 {
+#ifdef CONFIG_INT128
+    __uint128_t z = (((__uint128_t)a0 << 64) | a1) << count;
 
+    *z1Ptr = z;
+    *z0Ptr = z >> 64;
+#else
     *z1Ptr = a1<<count;
     *z0Ptr =
         ( count == 0 ) ? a0 : ( a0<<count ) | ( a1>>( ( - count ) & 63 ) );
-
+#endif
 }
 
 /*----------------------------------------------------------------------------
@@ -398,12 +426,19 @@ static inline void
  add128(
      uint64_t a0, uint64_t a1, uint64_t b0, uint64_t b1, uint64_t *z0Ptr, uint64_t *z1Ptr )
 {
+#ifdef CONFIG_INT128
+    __uint128_t z = (((__uint128_t)a0 << 64) | a1) +
+                    (((__uint128_t)b0 << 64) | b1);
+
+    *z1Ptr = z;
+    *z0Ptr = z >> 64;
+#else
     uint64_t z1;
 
     z1 = a1 + b1;
     *z1Ptr = z1;
     *z0Ptr = a0 + b0 + ( z1 < a1 );
-
+#endif
 }
 
 /*----------------------------------------------------------------------------
@@ -456,10 +491,16 @@ static inline void
  sub128(
      uint64_t a0, uint64_t a1, uint64_t b0, uint64_t b1, uint64_t *z0Ptr, uint64_t *z1Ptr )
 {
+#ifdef CONFIG_INT128
+    __uint128_t z = (((__uint128_t)a0 << 64) | a1) -
+                    (((__uint128_t)b0 << 64) | b1);
 
+    *z1Ptr = z;
+    *z0Ptr = z >> 64;
+#else
     *z1Ptr = a1 - b1;
     *z0Ptr = a0 - b0 - ( a1 < b1 );
-
+#endif
 }
 
 /*----------------------------------------------------------------------------
@@ -508,6 +549,12 @@ static inline void
 
 static inline void mul64To128( uint64_t a, uint64_t b, uint64_t *z0Ptr, uint64_t *z1Ptr )
 {
+#ifdef CONFIG_INT128
+    __uint128_t z = (__uint128_t)a * b;
+
+    *z1Ptr = z;
+    *z0Ptr = z >> 64;
+#else
     uint32_t aHigh, aLow, bHigh, bLow;
     uint64_t z0, zMiddleA, zMiddleB, z1;
 
@@ -526,7 +573,7 @@ static inline void mul64To128( uint64_t a, uint64_t b, uint64_t *z0Ptr, uint64_t
     z0 += ( z1 < zMiddleA );
     *z1Ptr = z1;
     *z0Ptr = z0;
-
+#endif
 }
 
 /*----------------------------------------------------------------------------
@@ -546,6 +593,14 @@ static inline void
      uint64_t *z2Ptr
  )
 {
+#ifdef CONFIG_INT128
+    __uint128_t lo = (__uint128_t)a1 * b;
+    __uint128_t hi = (__uint128_t)a0 * b + (uint64_t)(lo >> 64);
+
+    *z2Ptr = lo;
+    *z1Ptr = hi;
+    *z0Ptr = hi >> 64;
+#else
     uint64_t z0, z1, z2, more1;
 
     mul64To128( a1, b, &z1, &z2 );
@@ -554,7 +609,7 @@ static inline void
     *z2Ptr = z2;
     *z1Ptr = z1;
     *z0Ptr = z0;
-
+#endif
 }
 
 /*----------------------------------------------------------------------------
@@ -605,6 +660,25 @@ static inline void
 
 static uint64_t estimateDiv128To64( uint64_t a0, uint64_t a1, uint64_t b )
 {
+#ifdef CONFIG_INT128
+    /* Same estimate as below, with the 128-bit partial remainder held in
+       a single host integer.  */
+    __int128_t rem;
+    uint64_t b0, rem0;
+    uint64_t z;
+
+    if ( b <= a0 ) return LIT64( 0xFFFFFFFFFFFFFFFF );
+    b0 = b>>32;
+    z = ( b0<<32 <= a0 ) ? LIT64( 0xFFFFFFFF00000000 ) : ( a0 / b0 )<<32;
+    rem = ((((__uint128_t)a0 << 64) | a1) - (__uint128_t)b * z);
+    while (rem < 0) {
+        z -= LIT64( 0x100000000 );
+        rem += (__int128_t)b << 32;
+    }
+    rem0 = rem >> 32;
+    z |= ( b0<<32 <= rem0 ) ? 0xFFFFFFFF : rem0 / b0;
+    return z;
+#else
     uint64_t b0, b1;
     uint64_t rem0, rem1, term0, term1;
     uint64_t z;
@@ -622,7 +696,7 @@ static uint64_t estimateDiv128To64( uint64_t a0, uint64_t a1, uint64_t b )
     rem0 = ( rem0<<32 ) | ( rem1>>32 );
     z |= ( b0<<32 <= rem0 ) ? 0xFFFFFFFF : rem0 / b0;
     return z;
-
+#endif
 }
 
 /*----------------------------------------------------------------------------
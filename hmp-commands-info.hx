@@ -293,6 +293,23 @@ STEXI
 @item info opcount
 @findex info opcount
 Show dynamic compiler opcode counters
+ETEXI
+
+#if defined(CONFIG_TCG)
+    {
+        .name       = "tb-profile",
+        .args_type  = "limit:i?",
+        .params     = "[limit]",
+        .help       = "show the most executed guest code addresses",
+        .cmd        = hmp_info_tb_profile,
+    },
+#endif
+
+STEXI
+@item info tb-profile [@var{limit}]
+@findex info tb-profile
+Show the @var{limit} (default 20) guest addresses whose translated code
+was executed most often since @code{tb-profile on}, with their symbol.
 ETEXI
 
     {
@@ -323,6 +323,23 @@ STEXI
 @item log @var{item1}[,...]
 @findex log
 Activate logging of the specified items.
+ETEXI
+
+#if defined(CONFIG_TCG)
+    {
+        .name       = "tb-profile",
+        .args_type  = "option:s",
+        .params     = "on|off|reset",
+        .help       = "start, stop or reset counting translation block executions",
+        .cmd        = hmp_tb_profile,
+    },
+#endif
+
+STEXI
+@item tb-profile on|off|reset
+@findex tb-profile
+Start or stop counting how often each translation block is executed, or
+clear the counts.  Use @code{info tb-profile} to see the results.
 ETEXI
 
     {
@@ -263,6 +263,8 @@ int walk_memory_regions(void *, walk_memory_regions_fn);
 int page_get_flags(target_ulong address);
 void page_set_flags(target_ulong start, target_ulong end, int flags);
 int page_check_range(target_ulong start, target_ulong len, int flags);
+target_ulong page_find_range_empty_last(target_ulong end, target_ulong len,
+                                        target_ulong align);
 #endif
 
 CPUArchState *cpu_copy(CPUArchState *env);
@@ -341,6 +343,9 @@ CPUArchState *cpu_copy(CPUArchState *env);
 
 void dump_exec_info(FILE *f, fprintf_function cpu_fprintf);
 void dump_opcount_info(FILE *f, fprintf_function cpu_fprintf);
+void tb_profile_set_enabled(bool enable);
+void tb_profile_reset(void);
+GArray *tb_profile_snapshot(void);
 #endif /* !CONFIG_USER_ONLY */
 
 int cpu_memory_rw_debug(CPUState *cpu, target_ulong addr,
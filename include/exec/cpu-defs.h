@@ -25,6 +25,7 @@
 
 #include "qemu/host-utils.h"
 #include "qemu/queue.h"
+#include "qemu/thread.h"
 #ifdef CONFIG_TCG
 #include "tcg-target.h"
 #endif
@@ -66,6 +67,30 @@ typedef uint64_t target_ulong;
 #define CPU_TLB_ENTRY_BITS 5
 #endif
 
+#if TCG_TARGET_IMPLEMENTS_DYN_TLB
+/* The main TLB of each MMU mode is allocated separately, and its size is
+ * adjusted on every flush from the use rate seen since the previous one;
+ * see tlb_mmu_resize_locked.  The TCG backend loads the table pointer
+ * and index mask from env->tlb_table and env->tlb_mask.
+ *
+ * Only the i386 and TCI backends do so for now.  The others define
+ * TCG_TARGET_IMPLEMENTS_DYN_TLB to 0 and keep the fixed-size tables of
+ * CPU_TLB_SIZE entries below, which their TLB lookup code indexes with
+ * a constant mask.
+ */
+#define CPU_TLB_DYN_MIN_BITS 6
+#define CPU_TLB_DYN_DEFAULT_BITS 8
+
+# if HOST_LONG_BITS == 32
+/* Make sure the TLB index fits the single-word shift of the TLB load.  */
+#  define CPU_TLB_DYN_MAX_BITS (32 - TARGET_PAGE_BITS)
+# else
+#  define CPU_TLB_DYN_MAX_BITS \
+    MIN(22, TARGET_VIRT_ADDR_SPACE_BITS - TARGET_PAGE_BITS)
+# endif
+
+#else /* !TCG_TARGET_IMPLEMENTS_DYN_TLB */
+
 /* TCG_TARGET_TLB_DISPLACEMENT_BITS is used in CPU_TLB_BITS to ensure that
  * the TLB is not unnecessarily small, but still small enough for the
  * TLB lookup instruction sequence used by the TCG target.
@@ -98,6 +123,8 @@ typedef uint64_t target_ulong;
 
 #define CPU_TLB_SIZE (1 << CPU_TLB_BITS)
 
+#endif /* TCG_TARGET_IMPLEMENTS_DYN_TLB */
+
 typedef struct CPUTLBEntry {
     /* bit TARGET_LONG_BITS to TARGET_PAGE_BITS : virtual address
        bit TARGET_PAGE_BITS-1..4  : Nonzero for accesses that should not
@@ -131,12 +158,45 @@ typedef struct CPUIOTLBEntry {
     MemTxAttrs attrs;
 } CPUIOTLBEntry;
 
+/* Sizing state and statistics of the main TLB of one MMU mode.  */
+typedef struct CPUTLBDesc {
+    /* Start of the current sizing window, and the largest number of
+     * valid entries seen at a flush during it.
+     */
+    int64_t window_begin_ns;
+    size_t window_max_entries;
+    /* Number of valid entries in the main TLB.  */
+    size_t n_used_entries;
+    /* Counters for "info jit".  Misses of the main TLB are either
+     * victim TLB hits or fills through tlb_set_page.
+     */
+    size_t n_fill;
+    size_t n_victim_hit;
+    size_t n_resize;
+} CPUTLBDesc;
+
+#if TCG_TARGET_IMPLEMENTS_DYN_TLB
+#define CPU_COMMON_TLB_TABLES                                           \
+    /* (number of entries - 1) << CPU_TLB_ENTRY_BITS, per MMU mode */   \
+    uintptr_t tlb_mask[NB_MMU_MODES];                                   \
+    CPUTLBEntry *tlb_table[NB_MMU_MODES];                               \
+    CPUIOTLBEntry *iotlb[NB_MMU_MODES];                                 \
+    /* Protects the tables against resizing by tlb_flush while       \
+     * another thread walks them in tlb_reset_dirty.                 \
+     */                                                                 \
+    QemuSpin tlb_lock;
+#else
+#define CPU_COMMON_TLB_TABLES                                           \
+    CPUTLBEntry tlb_table[NB_MMU_MODES][CPU_TLB_SIZE];                  \
+    CPUIOTLBEntry iotlb[NB_MMU_MODES][CPU_TLB_SIZE];
+#endif
+
 #define CPU_COMMON_TLB \
     /* The meaning of the MMU modes is defined in the target code. */   \
-    CPUTLBEntry tlb_table[NB_MMU_MODES][CPU_TLB_SIZE];                  \
+    CPU_COMMON_TLB_TABLES                                               \
     CPUTLBEntry tlb_v_table[NB_MMU_MODES][CPU_VTLB_SIZE];               \
-    CPUIOTLBEntry iotlb[NB_MMU_MODES][CPU_TLB_SIZE];                    \
     CPUIOTLBEntry iotlb_v[NB_MMU_MODES][CPU_VTLB_SIZE];                 \
+    CPUTLBDesc tlb_d[NB_MMU_MODES];                                     \
     size_t tlb_flush_count;                                             \
     target_ulong tlb_flush_addr;                                        \
     target_ulong tlb_flush_mask;                                        \
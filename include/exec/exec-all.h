@@ -124,6 +124,21 @@ void tlb_flush_page_all_cpus(CPUState *src, target_ulong addr);
  * the guests translation ends the TB.
  */
 void tlb_flush_page_all_cpus_synced(CPUState *src, target_ulong addr);
+/**
+ * tlb_init:
+ * @cpu: CPU whose TLB should be initialized
+ *
+ * Allocate the TLB tables of a CPU, when their size is not fixed at
+ * compile time.
+ */
+void tlb_init(CPUState *cpu);
+/**
+ * tlb_destroy:
+ * @cpu: CPU whose TLB should be freed
+ *
+ * Free the TLB tables allocated by tlb_init.
+ */
+void tlb_destroy(CPUState *cpu);
 /**
  * tlb_flush:
  * @cpu: CPU whose TLB should be flushed
@@ -254,6 +269,12 @@ void tb_invalidate_phys_addr(AddressSpace *as, hwaddr addr);
 void probe_write(CPUArchState *env, target_ulong addr, int mmu_idx,
                  uintptr_t retaddr);
 #else
+static inline void tlb_init(CPUState *cpu)
+{
+}
+static inline void tlb_destroy(CPUState *cpu)
+{
+}
 static inline void tlb_flush_page(CPUState *cpu, target_ulong addr)
 {
 }
@@ -341,6 +362,7 @@ struct TranslationBlock {
 #define CF_USE_ICOUNT  0x00020000
 #define CF_INVALID     0x00040000 /* TB is stale. Setters need tb_lock */
 #define CF_PARALLEL    0x00080000 /* Generate code for a parallel context */
+#define CF_HOT         0x00100000 /* Translate as a superblock */
 /* cflags' mask for hashing/comparison */
 #define CF_HASH_MASK   \
     (CF_COUNT_MASK | CF_LAST_IO | CF_USE_ICOUNT | CF_PARALLEL)
@@ -382,9 +404,25 @@ struct TranslationBlock {
      */
     uintptr_t jmp_list_next[2];
     uintptr_t jmp_list_first;
+
+    /* Number of times the TB was entered, incremented by the code
+     * emitted by gen_tb_start when tb_profile_enabled is set, or for
+     * the TBs that are not yet hot when tb_hot_threshold is.  Updates
+     * from concurrent vCPUs are not atomic, so the count is approximate
+     * under MTTCG.
+     */
+    uint64_t exec_count;
 };
 
 extern bool parallel_cpus;
+extern bool tb_profile_enabled;
+extern unsigned tb_hot_threshold;
+
+/* Per guest PC execution count, as reported by tb_profile_snapshot.  */
+typedef struct TBProfileEntry {
+    uint64_t pc;
+    uint64_t count;
+} TBProfileEntry;
 
 /* Hide the atomic_read to make code a little easier on the eyes */
 static inline uint32_t tb_cflags(const TranslationBlock *tb)
@@ -402,6 +440,8 @@ static inline uint32_t curr_cflags(void)
 void tb_remove(TranslationBlock *tb);
 void tb_flush(CPUState *cpu);
 void tb_phys_invalidate(TranslationBlock *tb, tb_page_addr_t page_addr);
+void tb_mark_hot(TranslationBlock *tb);
+void tb_hot_set_threshold(unsigned threshold);
 TranslationBlock *tb_htable_lookup(CPUState *cpu, target_ulong pc,
                                    target_ulong cs_base, uint32_t flags,
                                    uint32_t cf_mask);
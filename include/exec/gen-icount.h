@@ -10,6 +10,7 @@ static int icount_start_insn_idx;
 static inline void gen_tb_start(TranslationBlock *tb)
 {
     TCGv_i32 count, imm;
+    bool hot;
 
     tcg_ctx->exitreq_label = gen_new_label();
     if (tb_cflags(tb) & CF_USE_ICOUNT) {
@@ -41,6 +42,35 @@ static inline void gen_tb_start(TranslationBlock *tb)
     }
 
     tcg_temp_free_i32(count);
+
+    /* TBs with an instruction count are one-offs, not worth tiering.  */
+    hot = tb_hot_threshold &&
+          !(tb_cflags(tb) & (CF_HOT | CF_NOCACHE | CF_COUNT_MASK));
+
+    if (tb_profile_enabled || hot) {
+        /* Plain load/add/store: a lost increment between vCPUs is
+         * cheaper than an atomic or a helper call on every TB entry.  */
+        TCGv_ptr ptr = tcg_const_ptr(&tb->exec_count);
+        TCGv_i64 exec_count = tcg_temp_new_i64();
+
+        tcg_gen_ld_i64(exec_count, ptr, 0);
+        tcg_gen_addi_i64(exec_count, exec_count, 1);
+        tcg_gen_st_i64(exec_count, ptr, 0);
+        tcg_temp_free_ptr(ptr);
+        if (hot) {
+            /* A lost increment may skip the threshold; the TB then
+             * stays cold, which is harmless.  */
+            TCGLabel *cold = gen_new_label();
+
+            tcg_gen_brcondi_i64(TCG_COND_NE, exec_count, tb_hot_threshold,
+                                cold);
+            ptr = tcg_const_ptr(tb);
+            gen_helper_tb_hot(ptr);
+            tcg_temp_free_ptr(ptr);
+            gen_set_label(cold);
+        }
+        tcg_temp_free_i64(exec_count);
+    }
 }
 
 static inline void gen_tb_end(TranslationBlock *tb, int num_insns)
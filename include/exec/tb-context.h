@@ -38,6 +38,7 @@ struct TBContext {
 
     /* statistics */
     unsigned tb_flush_count;
+    unsigned tb_evict_count;
     int tb_phys_invalidate_count;
 };
 
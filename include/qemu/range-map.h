@@ -0,0 +1,51 @@
+/*
+ * Ordered map from integer ranges to values.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+#ifndef QEMU_RANGE_MAP_H
+#define QEMU_RANGE_MAP_H
+
+/*
+ * A RangeMap gives a value to each point of [0, limit), initially 0.
+ * It is stored as the runs of points with the same value, in a balanced
+ * tree ordered by address, so that lookups, updates and searches for a
+ * free run (of value 0) take O(log n) for n runs.
+ *
+ * There is no locking, the caller must serialize accesses.
+ */
+typedef struct RangeMap RangeMap;
+
+RangeMap *range_map_new(uint64_t limit);
+void range_map_destroy(RangeMap *map);
+
+/**
+ * range_map_set - give a value to the points of [@start, @end)
+ *
+ * Both bounds must be within [0, limit].
+ */
+void range_map_set(RangeMap *map, uint64_t start, uint64_t end,
+                   unsigned value);
+
+/**
+ * range_map_get - return the value at @point
+ * @run_start, @run_end: if not NULL, set to the bounds of the largest
+ * range around @point with the same value
+ */
+unsigned range_map_get(RangeMap *map, uint64_t point,
+                       uint64_t *run_start, uint64_t *run_end);
+
+/**
+ * range_map_find_free_last - find the highest free range below a bound
+ * @end: the found range must end at or below @end
+ * @size: the size of the range, which must not be 0
+ * @align: the start of the range must be a multiple of this power of 2
+ * @start: set to the start of the range
+ *
+ * Return true if there is a range of @size points with value 0.
+ */
+bool range_map_find_free_last(RangeMap *map, uint64_t end, uint64_t size,
+                              uint64_t align, uint64_t *start);
+
+#endif
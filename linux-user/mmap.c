@@ -21,6 +21,7 @@
 #include "qemu.h"
 #include "qemu-common.h"
 #include "translate-all.h"
+#include "tb-cache.h"
 
 //#define DEBUG_MMAP
 
@@ -206,8 +207,6 @@ static abi_ulong mmap_find_vma_reserved(abi_ulong start, abi_ulong size)
 {
     abi_ulong addr;
     abi_ulong end_addr;
-    int prot;
-    int looped = 0;
 
     if (size > reserved_va) {
         return (abi_ulong)-1;
@@ -218,26 +217,16 @@ static abi_ulong mmap_find_vma_reserved(abi_ulong start, abi_ulong size)
     if (end_addr > reserved_va) {
         end_addr = reserved_va;
     }
-    addr = end_addr - qemu_host_page_size;
 
-    while (1) {
-        if (addr > end_addr) {
-            if (looped) {
-                return (abi_ulong)-1;
-            }
-            end_addr = reserved_va;
-            addr = end_addr - qemu_host_page_size;
-            looped = 1;
-            continue;
-        }
-        prot = page_get_flags(addr);
-        if (prot) {
-            end_addr = addr;
-        }
-        if (addr + size == end_addr) {
-            break;
+    /* Take the highest free area that ends at or below start + size, or
+       else the highest of all.  */
+    addr = page_find_range_empty_last(end_addr, size, qemu_host_page_size);
+    if (addr == (abi_ulong)-1) {
+        addr = page_find_range_empty_last(reserved_va, size,
+                                          qemu_host_page_size);
+        if (addr == (abi_ulong)-1) {
+            return (abi_ulong)-1;
         }
-        addr -= qemu_host_page_size;
     }
 
     if (start == mmap_next_start) {
@@ -554,6 +543,7 @@ abi_long target_mmap(abi_ulong start, abi_ulong len, int prot,
     }
  the_end1:
     page_set_flags(start, start + len, prot | PAGE_VALID);
+    tb_cache_map(start, len, prot, flags & MAP_ANONYMOUS ? -1 : fd);
  the_end:
 #ifdef DEBUG_MMAP
     printf("ret=0x" TARGET_ABI_FMT_lx "\n", start);
@@ -665,6 +655,7 @@ int target_munmap(abi_ulong start, abi_ulong len)
 
     if (ret == 0) {
         page_set_flags(start, start + len, 0);
+        tb_cache_unmap(start, len);
         tb_invalidate_phys_range(start, start + len);
     }
     mmap_unlock();
@@ -739,6 +730,8 @@ abi_long target_mremap(abi_ulong old_addr, abi_ulong old_size,
         prot = page_get_flags(old_addr);
         page_set_flags(old_addr, old_addr + old_size, 0);
         page_set_flags(new_addr, new_addr + new_size, prot | PAGE_VALID);
+        tb_cache_unmap(old_addr, old_size);
+        tb_cache_unmap(new_addr, new_size);
     }
     tb_invalidate_phys_range(new_addr, new_addr + new_size);
     mmap_unlock();
@@ -115,7 +115,6 @@ typedef struct TaskState {
     abi_ulong child_tidptr;
 #ifdef TARGET_M68K
     int sim_syscalls;
-    abi_ulong tp_value;
 #endif
 #if defined(TARGET_ARM) || defined(TARGET_M68K) || defined(TARGET_UNICORE32)
     /* Extra fields for semihosted binaries.  */
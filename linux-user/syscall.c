@@ -11663,12 +11663,9 @@ abi_long do_syscall(void *cpu_env, int num, abi_long arg1,
       ret = do_set_thread_area(cpu_env, arg1);
       break;
 #elif defined(TARGET_M68K)
-      {
-          TaskState *ts = cpu->opaque;
-          ts->tp_value = arg1;
-          ret = 0;
-          break;
-      }
+      ((CPUM68KState *) cpu_env)->tp_value = arg1;
+      ret = 0;
+      break;
 #else
       goto unimplemented_nowarn;
 #endif
@@ -11679,11 +11676,9 @@ abi_long do_syscall(void *cpu_env, int num, abi_long arg1,
         ret = do_get_thread_area(cpu_env, arg1);
         break;
 #elif defined(TARGET_M68K)
-        {
-            TaskState *ts = cpu->opaque;
-            ret = ts->tp_value;
-            break;
-        }
+        /* Normally handled inline by the translator.  */
+        ret = ((CPUM68KState *) cpu_env)->tp_value;
+        break;
 #else
         goto unimplemented_nowarn;
 #endif
@@ -12215,7 +12210,8 @@ abi_long do_syscall(void *cpu_env, int num, abi_long arg1,
 #ifdef TARGET_NR_atomic_cmpxchg_32
     case TARGET_NR_atomic_cmpxchg_32:
     {
-        /* should use start_exclusive from main.c */
+        /* Normally handled atomically by the m68k translator; this
+           fallback is not atomic.  */
         abi_ulong mem_value;
         if (get_user_u32(mem_value, arg6)) {
             target_siginfo_t info;
@@ -12226,7 +12222,7 @@ abi_long do_syscall(void *cpu_env, int num, abi_long arg1,
             queue_signal((CPUArchState *)cpu_env, info.si_signo,
                          QEMU_SI_FAULT, &info);
             ret = 0xdeadbeef;
-
+            break;
         }
         if (mem_value == arg2)
             put_user_u32(arg1, arg6);
@@ -1128,7 +1128,94 @@ static void hmp_info_opcount(Monitor *mon, const QDict *qdict)
 {
     dump_opcount_info((FILE *)mon, monitor_fprintf);
 }
+
+static void hmp_tb_profile(Monitor *mon, const QDict *qdict)
+{
+    const char *option = qdict_get_str(qdict, "option");
+
+    if (!tcg_enabled()) {
+        error_report("TB profiling is only available with accel=tcg");
+        return;
+    }
+
+    if (!strcmp(option, "on")) {
+        tb_profile_set_enabled(true);
+    } else if (!strcmp(option, "off")) {
+        tb_profile_set_enabled(false);
+    } else if (!strcmp(option, "reset")) {
+        tb_profile_reset();
+    } else {
+        monitor_printf(mon, "unexpected option %s\n", option);
+    }
+}
+
+static void hmp_info_tb_profile(Monitor *mon, const QDict *qdict)
+{
+    Error *err = NULL;
+    TBProfileInfoList *list, *info;
+    int64_t limit = qdict_get_try_int(qdict, "limit", 20);
+
+    if (limit <= 0) {
+        monitor_printf(mon, "limit must be positive\n");
+        return;
+    }
+    list = qmp_query_tb_profile(true, MIN(limit, UINT32_MAX), &err);
+    if (err) {
+        error_report_err(err);
+        return;
+    }
+    if (!tb_profile_enabled) {
+        monitor_printf(mon, "TB profiling is off, use \"tb-profile on\"\n");
+    }
+    for (info = list; info; info = info->next) {
+        monitor_printf(mon, "0x%016" PRIx64 " %20" PRIu64 "  %s\n",
+                       info->value->pc, info->value->count,
+                       info->value->has_symbol ? info->value->symbol : "");
+    }
+    qapi_free_TBProfileInfoList(list);
+}
+#endif
+
+TBProfileInfoList *qmp_query_tb_profile(bool has_limit, uint32_t limit,
+                                        Error **errp)
+{
+#ifdef CONFIG_TCG
+    TBProfileInfoList *head = NULL, **tail = &head;
+    GArray *entries;
+    guint i;
+
+    if (!tcg_enabled()) {
+        error_setg(errp, "TB profiling is only available with accel=tcg");
+        return NULL;
+    }
+    if (!has_limit) {
+        limit = 20;
+    }
+
+    entries = tb_profile_snapshot();
+    for (i = 0; i < entries->len && i < limit; i++) {
+        TBProfileEntry *e = &g_array_index(entries, TBProfileEntry, i);
+        TBProfileInfoList *elem = g_new0(TBProfileInfoList, 1);
+        TBProfileInfo *info = g_new0(TBProfileInfo, 1);
+        const char *symbol = lookup_symbol(e->pc);
+
+        info->pc = e->pc;
+        info->count = e->count;
+        if (*symbol) {
+            info->has_symbol = true;
+            info->symbol = g_strdup(symbol);
+        }
+        elem->value = info;
+        *tail = elem;
+        tail = &elem->next;
+    }
+    g_array_free(entries, true);
+    return head;
+#else
+    error_setg(errp, "TB profiling is only available with accel=tcg");
+    return NULL;
 #endif
+}
 
 static void hmp_info_history(Monitor *mon, const QDict *qdict)
 {
@@ -119,9 +119,14 @@ Select CPU model (@code{-cpu help} for list and additional feature selection)
 ETEXI
 
 DEF("accel", HAS_ARG, QEMU_OPTION_accel,
-    "-accel [accel=]accelerator[,thread=single|multi]\n"
+    "-accel [accel=]accelerator[,thread=single|multi][,perfmap=on|off]\n"
+    "                [,jitdump=on|off][,hot-threshold=n]\n"
     "                select accelerator (kvm, xen, hax or tcg; use 'help' for a list)\n"
-    "                thread=single|multi (enable multi-threaded TCG)\n", QEMU_ARCH_ALL)
+    "                thread=single|multi (enable multi-threaded TCG)\n"
+    "                perfmap=on|off (write /tmp/perf-${pid}.map for perf)\n"
+    "                jitdump=on|off (write jit-${pid}.dump for perf)\n"
+    "                hot-threshold=n (retranslate code run n times as superblocks)\n",
+    QEMU_ARCH_ALL)
 STEXI
 @item -accel @var{name}[,prop=@var{value}[,...]]
 @findex -accel
@@ -135,6 +140,22 @@ Controls number of TCG threads. When the TCG is multi-threaded there will be one
 thread per vCPU therefor taking advantage of additional host cores. The default
 is to enable multi-threading where both the back-end and front-ends support it and
 no incompatible TCG features have been enabled (e.g. icount/replay).
+@item perfmap=on|off
+Write the host address range of every translation block, named after its
+guest address and symbol, to @file{/tmp/perf-<pid>.map}, which
+@command{perf report} uses to name samples in translated code.  The file
+is restarted when the translation cache is flushed.
+@item jitdump=on|off
+Write every translation block and its code to @file{jit-<pid>.dump} in the
+current directory, for use with @command{perf record -k 1} followed by
+@command{perf inject --jit}.  Unlike the perf map, this remains accurate
+across translation cache flushes.
+@item hot-threshold=@var{n}
+Translate the guest code again once a translation block of it has run
+@var{n} times.  Where the guest supports it (currently m68k), the new
+block is a superblock that follows forward branches, leaving through side
+exits when a conditional branch is taken.  Until then, each block counts
+its executions.  The default, 0, disables this.
 @end table
 ETEXI
 
@@ -0,0 +1,58 @@
+#!/bin/sh
+#
+# Compare the run time of many short-lived user-mode processes with and
+# without the persistent TB cache (-tb-cache).
+#
+# Usage: tb-cache-bench.sh [-n RUNS] QEMU GUEST-PROGRAM [ARGS...]
+#
+# e.g. QEMU_LD_PREFIX=/srv/m68k-root \
+#      scripts/tb-cache-bench.sh -n 200 ./m68k-linux-user/qemu-m68k \
+#      /srv/m68k-root/usr/bin/gcc -c -o /dev/null hello.c
+#
+# Each run is a separate QEMU process, as in a configure script or a
+# build.  The cache is filled by one warm-up run before it is measured.
+#
+# This work is licensed under the terms of the GNU GPL, version 2 or later.
+# See the COPYING file in the top-level directory.
+
+runs=100
+if [ "$1" = "-n" ]; then
+    runs=$2
+    shift 2
+fi
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 [-n RUNS] QEMU GUEST-PROGRAM [ARGS...]" >&2
+    exit 1
+fi
+qemu=$1
+shift
+
+cache_dir=$(mktemp -d "${TMPDIR:-/tmp}/tb-cache-bench.XXXXXX") || exit 1
+trap 'rm -rf "$cache_dir"' EXIT
+
+now() {
+    date +%s.%N
+}
+
+# Fill the cache.
+"$qemu" -tb-cache "$cache_dir" "$@" >/dev/null 2>&1 </dev/null
+
+for mode in "no cache" "tb-cache"; do
+    if [ "$mode" = "tb-cache" ]; then
+        opts="-tb-cache $cache_dir"
+    else
+        opts=
+    fi
+    start=$(now)
+    i=0
+    while [ $i -lt "$runs" ]; do
+        "$qemu" $opts "$@" >/dev/null 2>&1 </dev/null
+        i=$((i + 1))
+    done
+    end=$(now)
+    echo "$start $end" | awk -v mode="$mode" -v runs="$runs" '{
+        t = $2 - $1
+        printf "%-10s %8.3f s %8.2f ms/run\n", mode, t, t * 1000 / runs
+    }'
+done
+du -sh "$cache_dir" | awk '{ print "cache size " $1 }'
@@ -0,0 +1,54 @@
+#!/bin/sh
+#
+# Compare the run time of a user-mode workload under the TCG interpreter
+# (TCI) and under native TCG.
+#
+# Usage: tci-bench.sh [-n RUNS] QEMU-TCI QEMU-NATIVE GUEST-PROGRAM [ARGS...]
+#
+# e.g. QEMU_LD_PREFIX=/srv/m68k-root \
+#      scripts/tci-bench.sh -n 5 \
+#      build-tci/m68k-linux-user/qemu-m68k \
+#      build/m68k-linux-user/qemu-m68k \
+#      /srv/m68k-root/usr/bin/gzip -9 -c /srv/m68k-root/usr/bin/gzip
+#
+# QEMU-TCI comes from a build configured with --enable-tcg-interpreter,
+# QEMU-NATIVE from one of the same source tree without it.
+#
+# This work is licensed under the terms of the GNU GPL, version 2 or later.
+# See the COPYING file in the top-level directory.
+
+runs=3
+if [ "$1" = "-n" ]; then
+    runs=$2
+    shift 2
+fi
+if [ $# -lt 3 ]; then
+    echo "Usage: $0 [-n RUNS] QEMU-TCI QEMU-NATIVE GUEST-PROGRAM [ARGS...]" >&2
+    exit 1
+fi
+qemu_tci=$1
+qemu_native=$2
+shift 2
+
+now() {
+    date +%s.%N
+}
+
+for mode in tci native; do
+    if [ "$mode" = "tci" ]; then
+        qemu=$qemu_tci
+    else
+        qemu=$qemu_native
+    fi
+    start=$(now)
+    i=0
+    while [ $i -lt "$runs" ]; do
+        "$qemu" "$@" >/dev/null 2>&1 </dev/null
+        i=$((i + 1))
+    done
+    end=$(now)
+    echo "$start $end" | awk -v mode="$mode" -v runs="$runs" '{
+        t = $2 - $1
+        printf "%-10s %8.3f s %8.2f ms/run\n", mode, t, t * 1000 / runs
+    }'
+done
@@ -45,6 +45,8 @@
 #define EXCP_ADDRESS        3   /* Address error.  */
 #define EXCP_ILLEGAL        4   /* Illegal instruction.  */
 #define EXCP_DIV0           5   /* Divide by zero */
+#define EXCP_CHK            6   /* CHK, CHK2 instructions.  */
+#define EXCP_TRAPCC         7   /* FTRAPcc, TRAPcc, TRAPV instructions.  */
 #define EXCP_PRIVILEGE      8   /* Privilege violation.  */
 #define EXCP_TRACE          9
 #define EXCP_LINEA          10  /* Unimplemented line-A (MAC) opcode.  */
@@ -70,9 +72,25 @@
 
 #define NB_MMU_MODES 2
 #define TARGET_INSN_START_EXTRA_WORDS 1
+/* The translator puts no host addresses in the code it generates.  */
+#define TARGET_SUPPORTS_TB_CACHE
 
 typedef CPU_LDoubleU FPReg;
 
+/* The 68040/68060 ATC is emulated by a direct mapped cache of page
+   translations, tagged by logical page, function code and root pointer
+   so that switching URP between address spaces does not discard it.
+   The softmmu TLB is refilled from it at TARGET_PAGE_SIZE granularity.  */
+#define M68K_ATC_BITS 9
+#define M68K_ATC_SIZE (1 << M68K_ATC_BITS)
+
+typedef struct M68kATCEntry {
+    uint32_t tag;       /* logical page | function code << 1 | valid */
+    uint32_t root;      /* URP or SRP used for the table walk */
+    uint32_t desc;      /* page descriptor, W includes upper levels */
+    uint32_t desc_addr; /* physical address of the page descriptor */
+} M68kATCEntry;
+
 typedef struct CPUM68KState {
     uint32_t dregs[8];
     uint32_t aregs[8];
@@ -82,6 +100,9 @@ typedef struct CPUM68KState {
     /* SSP and USP.  The current_sp is stored in aregs[7], the other here.  */
     int current_sp;
     uint32_t sp[2];
+    /* 68020-68040 master stack pointer.  SR.M is not implemented, so
+       this is only ever accessed through MOVEC.  */
+    uint32_t msp;
 
     /* Condition flags.  */
     uint32_t cc_op;
@@ -108,13 +129,30 @@ typedef struct CPUM68KState {
     /* MMU status.  */
     struct {
         uint32_t ar;
+        uint32_t ssw;
+        /* 68040/68060 MMU registers.  */
+        uint16_t tcr;
+        uint32_t urp;
+        uint32_t srp;
+        uint32_t mmusr;
+        uint32_t ttr[4];
     } mmu;
 
+    /* Software address translation cache of the 68040/68060 MMU.  */
+    M68kATCEntry atc[M68K_ATC_SIZE];
+
     /* Control registers.  */
     uint32_t vbr;
     uint32_t mbar;
     uint32_t rambar0;
     uint32_t cacr;
+    uint32_t sfc;
+    uint32_t dfc;
+    uint32_t pcr;   /* 68060 processor configuration register */
+    uint32_t buscr; /* 68060 bus control register */
+
+    /* Thread pointer for linux-user set_thread_area/get_thread_area.  */
+    uint32_t tp_value;
 
     int pending_vector;
     int pending_level;
@@ -172,6 +210,9 @@ uint32_t cpu_m68k_get_ccr(CPUM68KState *env);
 void cpu_m68k_set_ccr(CPUM68KState *env, uint32_t);
 void cpu_m68k_set_fpcr(CPUM68KState *env, uint32_t val);
 void cpu_m68k_set_fpsr(CPUM68KState *env, uint32_t val);
+void *m68k_bulk_access_begin(CPUM68KState *env, uint32_t addr, int len,
+                             MMUAccessType access_type, uintptr_t ra);
+void m68k_bulk_access_end(void);
 
 
 /* Instead of computing the condition codes after each m68k instruction,
@@ -276,6 +317,55 @@ typedef enum {
 /* CACR fields are implementation defined, but some bits are common.  */
 #define M68K_CACR_EUSP  0x10
 
+/* 68060 processor configuration register.  The upper half identifies
+   a full 68060, revision 1.  Only EDEBUG, DFP and ESS are writable.  */
+#define M68K_PCR_ID       0x04300100
+#define M68K_PCR_WRITABLE 0x00000083
+
+/* 68040/68060 MMU translation control register */
+#define M68K_TCR_ENABLED 0x8000
+#define M68K_TCR_PAGE_8K 0x4000
+
+/* Transparent translation registers */
+#define M68K_TTR_ADDRESS_BASE 0xff000000
+#define M68K_TTR_ADDRESS_MASK 0x00ff0000
+#define M68K_TTR_ENABLED      0x00008000
+#define M68K_TTR_SFIELD       0x00006000
+#define M68K_TTR_SFIELD_USER  0x0000
+#define M68K_TTR_SFIELD_SUPER 0x2000
+#define M68K_TTR_WRITE_PROT   0x00000004
+
+#define M68K_ITTR0 0
+#define M68K_ITTR1 1
+#define M68K_DTTR0 2
+#define M68K_DTTR1 3
+
+/* Table and page descriptors */
+#define M68K_DESC_RESIDENT    0x00000002 /* root and pointer UDT */
+#define M68K_DESC_WRITEPROT   0x00000004
+#define M68K_DESC_USED        0x00000008
+#define M68K_DESC_MODIFIED    0x00000010
+#define M68K_DESC_SUPERVISOR  0x00000080
+#define M68K_DESC_GLOBAL      0x00000400
+#define M68K_PDT_MASK         0x00000003
+#define M68K_PDT_INVALID      0x00000000
+#define M68K_PDT_INDIRECT     0x00000002
+
+/* MMU status register */
+#define M68K_MMU_R_040        0x0001 /* resident */
+#define M68K_MMU_T_040        0x0002 /* transparent */
+#define M68K_MMU_WP_040       0x0004 /* write protected */
+#define M68K_MMU_M_040        0x0010 /* modified */
+#define M68K_MMU_SUPER_040    0x0080 /* supervisor only */
+#define M68K_MMU_GLOBAL_040   0x0400 /* global */
+
+/* 68040 access error special status word */
+#define M68K_SSW_ATC_040      0x0400 /* fault detected by the MMU */
+#define M68K_SSW_RW_040       0x0100 /* read access */
+#define M68K_SSW_TM_SUPER     0x0004
+#define M68K_SSW_TM_CODE      0x0002
+#define M68K_SSW_TM_DATA      0x0001
+
 #define MACSR_PAV0  0x100
 #define MACSR_OMC   0x080
 #define MACSR_SU    0x040
@@ -317,6 +407,9 @@ enum m68k_features {
     M68K_FEATURE_CAS,
     M68K_FEATURE_BKPT,
     M68K_FEATURE_RTD,
+    M68K_FEATURE_M68040_MMU, /* 68040/68060 paged MMU.  */
+    M68K_FEATURE_MOVEC, /* 68010+ MOVEC.  */
+    M68K_FEATURE_M68060, /* 68060 control registers PCR and BUSCR.  */
 };
 
 static inline int m68k_feature(CPUM68KState *env, int feature)
@@ -353,6 +446,7 @@ void register_m68k_insns (CPUM68KState *env);
 /* MMU modes definitions */
 #define MMU_MODE0_SUFFIX _kernel
 #define MMU_MODE1_SUFFIX _user
+#define MMU_KERNEL_IDX 0
 #define MMU_USER_IDX 1
 static inline int cpu_mmu_index (CPUM68KState *env, bool ifetch)
 {
@@ -369,7 +463,8 @@ static inline void cpu_get_tb_cpu_state(CPUM68KState *env, target_ulong *pc,
 {
     *pc = env->pc;
     *cs_base = 0;
-    *flags = (env->sr & SR_S)                   /* Bit  13 */
+    *flags = (env->sr & SR_T)                   /* Bit  15 */
+            | (env->sr & SR_S)                  /* Bit  13 */
             | ((env->macsr >> 4) & 0xf);        /* Bits 0-3 */
 }
 
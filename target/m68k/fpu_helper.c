@@ -23,6 +23,7 @@
 #include "exec/helper-proto.h"
 #include "exec/exec-all.h"
 #include "exec/cpu_ldst.h"
+#include "fpu_host.h"
 
 /* Undefined offsets may be different on various FPU.
  * On 68040 they return 0.0 (floatx80_zero)
@@ -232,6 +233,196 @@ void HELPER(set_fpcr)(CPUM68KState *env, uint32_t val)
         set_floatx80_rounding_precision(old, &env->fp_status);  \
     } while (0)
 
+/* Host floating point fast path, see fpu_host.h.
+ *
+ * It is taken when FPCR selects single or double precision, rounding
+ * to nearest and no exception.  The host functions also tell whether
+ * the result is inexact, the only flag they can raise, which goes into
+ * fp_status like the flags of softfloat.
+ *
+ * Define DEBUG_FPU_FASTPATH to cross-check every fast path result
+ * against softfloat.
+ */
+//#define DEBUG_FPU_FASTPATH
+
+static inline int fpu_prec(CPUM68KState *env)
+{
+    return get_floatx80_rounding_precision(&env->fp_status);
+}
+
+static inline bool fpu_fast_path_ok(CPUM68KState *env)
+{
+    return (env->fpcr & (FPCR_RND_MASK | FPCR_EXCP_MASK)) == FPCR_RND_N;
+}
+
+#ifdef DEBUG_FPU_FASTPATH
+static floatx80 fpu_softfloat_op(FPUOp op, floatx80 a, floatx80 b,
+                                 float_status *status)
+{
+    switch (op) {
+    case FPU_OP_ADD:
+        return floatx80_add(a, b, status);
+    case FPU_OP_SUB:
+        return floatx80_sub(a, b, status);
+    case FPU_OP_MUL:
+        return floatx80_mul(a, b, status);
+    case FPU_OP_DIV:
+        return floatx80_div(a, b, status);
+    case FPU_OP_SQRT:
+        return floatx80_sqrt(a, status);
+    default:
+        g_assert_not_reached();
+    }
+}
+#endif
+
+/* Compute A op B (or sqrt(A)) rounded to PREC bits on the host FPU.
+   Return false if the softfloat code must be used instead.  */
+static bool fpu_fast_op(CPUM68KState *env, int prec, FPUOp op,
+                        floatx80 a, floatx80 b, floatx80 *res)
+{
+    floatx80 r;
+    bool ok, inexact;
+
+    if (!fpu_fast_path_ok(env)) {
+        return false;
+    }
+    switch (prec) {
+    case 64:
+        ok = fpu_fast_op_f64(op, a, b, &r, &inexact);
+        break;
+    case 32:
+        ok = fpu_fast_op_f32(op, a, b, &r, &inexact);
+        break;
+    default:
+        return false;
+    }
+    if (!ok) {
+        return false;
+    }
+#ifdef DEBUG_FPU_FASTPATH
+    {
+        float_status status = env->fp_status;
+        floatx80 check;
+
+        set_floatx80_rounding_precision(prec, &status);
+        set_float_exception_flags(0, &status);
+        check = fpu_softfloat_op(op, a, b, &status);
+        if (check.high != r.high || check.low != r.low ||
+            get_float_exception_flags(&status) !=
+            (inexact ? float_flag_inexact : 0)) {
+            fprintf(stderr, "m68k FPU fast path mismatch: op %d prec %d "
+                    "a %04x %016" PRIx64 " b %04x %016" PRIx64
+                    " host %04x %016" PRIx64 " softfloat %04x %016" PRIx64
+                    " flags %02x\n", op, prec, a.high, a.low, b.high, b.low,
+                    r.high, r.low, check.high, check.low,
+                    get_float_exception_flags(&status));
+            abort();
+        }
+    }
+#endif
+    if (inexact) {
+        float_raise(float_flag_inexact, &env->fp_status);
+    }
+    *res = r;
+    return true;
+}
+
+#ifdef DEBUG_FPU_FASTPATH
+static floatx80 fpu_softfloat_func(FPUFunc func, floatx80 a,
+                                   float_status *status)
+{
+    switch (func) {
+    case FPU_FUNC_SIN:
+        return floatx80_sin(a, status);
+    case FPU_FUNC_COS:
+        return floatx80_cos(a, status);
+    case FPU_FUNC_TAN:
+        return floatx80_tan(a, status);
+    case FPU_FUNC_ASIN:
+        return floatx80_asin(a, status);
+    case FPU_FUNC_ACOS:
+        return floatx80_acos(a, status);
+    case FPU_FUNC_ATAN:
+        return floatx80_atan(a, status);
+    case FPU_FUNC_SINH:
+        return floatx80_sinh(a, status);
+    case FPU_FUNC_COSH:
+        return floatx80_cosh(a, status);
+    case FPU_FUNC_TANH:
+        return floatx80_tanh(a, status);
+    case FPU_FUNC_ATANH:
+        return floatx80_atanh(a, status);
+    case FPU_FUNC_ETOX:
+        return floatx80_etox(a, status);
+    case FPU_FUNC_TWOTOX:
+        return floatx80_twotox(a, status);
+    case FPU_FUNC_TENTOX:
+        return floatx80_tentox(a, status);
+    case FPU_FUNC_LOGN:
+        return floatx80_logn(a, status);
+    case FPU_FUNC_LOGNP1:
+        return floatx80_lognp1(a, status);
+    case FPU_FUNC_LOG10:
+        return floatx80_log10(a, status);
+    case FPU_FUNC_LOG2:
+        return floatx80_log2(a, status);
+    default:
+        g_assert_not_reached();
+    }
+}
+#endif
+
+/* Compute FUNC(A) rounded to the FPCR precision on the host, which is
+   always inexact.  Return false if the FPSP code must be used instead.  */
+static bool fpu_fast_func(CPUM68KState *env, FPUFunc func,
+                          floatx80 a, floatx80 *res)
+{
+    int prec = fpu_prec(env);
+    floatx80 r;
+    bool ok;
+
+    if (!fpu_fast_path_ok(env)) {
+        return false;
+    }
+    switch (prec) {
+    case 64:
+        ok = fpu_fast_func_f64(func, a, &r);
+        break;
+    case 32:
+        ok = fpu_fast_func_f32(func, a, &r);
+        break;
+    default:
+        return false;
+    }
+    if (!ok) {
+        return false;
+    }
+#ifdef DEBUG_FPU_FASTPATH
+    {
+        float_status status = env->fp_status;
+        floatx80 check;
+
+        /* The FPSP code is not always correctly rounded, so only report
+           the differences.  */
+        set_float_exception_flags(0, &status);
+        check = fpu_softfloat_func(func, a, &status);
+        if (check.high != r.high || check.low != r.low ||
+            get_float_exception_flags(&status) != float_flag_inexact) {
+            fprintf(stderr, "m68k FPU fast path difference: func %d prec %d "
+                    "a %04x %016" PRIx64 " host %04x %016" PRIx64
+                    " fpsp %04x %016" PRIx64 " flags %02x\n",
+                    func, prec, a.high, a.low, r.high, r.low,
+                    check.high, check.low,
+                    get_float_exception_flags(&status));
+        }
+    }
+#endif
+    float_raise(float_flag_inexact, &env->fp_status);
+    *res = r;
+    return true;
+}
+
 void HELPER(fsround)(CPUM68KState *env, FPReg *res, FPReg *val)
 {
     PREC_BEGIN(32);
@@ -248,11 +439,17 @@ void HELPER(fdround)(CPUM68KState *env, FPReg *res, FPReg *val)
 
 void HELPER(fsqrt)(CPUM68KState *env, FPReg *res, FPReg *val)
 {
+    if (fpu_fast_op(env, fpu_prec(env), FPU_OP_SQRT, val->d, val->d, &res->d)) {
+        return;
+    }
     res->d = floatx80_sqrt(val->d, &env->fp_status);
 }
 
 void HELPER(fssqrt)(CPUM68KState *env, FPReg *res, FPReg *val)
 {
+    if (fpu_fast_op(env, 32, FPU_OP_SQRT, val->d, val->d, &res->d)) {
+        return;
+    }
     PREC_BEGIN(32);
     res->d = floatx80_sqrt(val->d, &env->fp_status);
     PREC_END();
@@ -260,6 +457,9 @@ void HELPER(fssqrt)(CPUM68KState *env, FPReg *res, FPReg *val)
 
 void HELPER(fdsqrt)(CPUM68KState *env, FPReg *res, FPReg *val)
 {
+    if (fpu_fast_op(env, 64, FPU_OP_SQRT, val->d, val->d, &res->d)) {
+        return;
+    }
     PREC_BEGIN(64);
     res->d = floatx80_sqrt(val->d, &env->fp_status);
     PREC_END();
@@ -305,11 +505,18 @@ void HELPER(fdneg)(CPUM68KState *env, FPReg *res, FPReg *val)
 
 void HELPER(fadd)(CPUM68KState *env, FPReg *res, FPReg *val0, FPReg *val1)
 {
+    if (fpu_fast_op(env, fpu_prec(env), FPU_OP_ADD,
+                    val0->d, val1->d, &res->d)) {
+        return;
+    }
     res->d = floatx80_add(val0->d, val1->d, &env->fp_status);
 }
 
 void HELPER(fsadd)(CPUM68KState *env, FPReg *res, FPReg *val0, FPReg *val1)
 {
+    if (fpu_fast_op(env, 32, FPU_OP_ADD, val0->d, val1->d, &res->d)) {
+        return;
+    }
     PREC_BEGIN(32);
     res->d = floatx80_add(val0->d, val1->d, &env->fp_status);
     PREC_END();
@@ -317,6 +524,9 @@ void HELPER(fsadd)(CPUM68KState *env, FPReg *res, FPReg *val0, FPReg *val1)
 
 void HELPER(fdadd)(CPUM68KState *env, FPReg *res, FPReg *val0, FPReg *val1)
 {
+    if (fpu_fast_op(env, 64, FPU_OP_ADD, val0->d, val1->d, &res->d)) {
+        return;
+    }
     PREC_BEGIN(64);
     res->d = floatx80_add(val0->d, val1->d, &env->fp_status);
     PREC_END();
@@ -324,11 +534,18 @@ void HELPER(fdadd)(CPUM68KState *env, FPReg *res, FPReg *val0, FPReg *val1)
 
 void HELPER(fsub)(CPUM68KState *env, FPReg *res, FPReg *val0, FPReg *val1)
 {
+    if (fpu_fast_op(env, fpu_prec(env), FPU_OP_SUB,
+                    val1->d, val0->d, &res->d)) {
+        return;
+    }
     res->d = floatx80_sub(val1->d, val0->d, &env->fp_status);
 }
 
 void HELPER(fssub)(CPUM68KState *env, FPReg *res, FPReg *val0, FPReg *val1)
 {
+    if (fpu_fast_op(env, 32, FPU_OP_SUB, val1->d, val0->d, &res->d)) {
+        return;
+    }
     PREC_BEGIN(32);
     res->d = floatx80_sub(val1->d, val0->d, &env->fp_status);
     PREC_END();
@@ -336,6 +553,9 @@ void HELPER(fssub)(CPUM68KState *env, FPReg *res, FPReg *val0, FPReg *val1)
 
 void HELPER(fdsub)(CPUM68KState *env, FPReg *res, FPReg *val0, FPReg *val1)
 {
+    if (fpu_fast_op(env, 64, FPU_OP_SUB, val1->d, val0->d, &res->d)) {
+        return;
+    }
     PREC_BEGIN(64);
     res->d = floatx80_sub(val1->d, val0->d, &env->fp_status);
     PREC_END();
@@ -343,11 +563,18 @@ void HELPER(fdsub)(CPUM68KState *env, FPReg *res, FPReg *val0, FPReg *val1)
 
 void HELPER(fmul)(CPUM68KState *env, FPReg *res, FPReg *val0, FPReg *val1)
 {
+    if (fpu_fast_op(env, fpu_prec(env), FPU_OP_MUL,
+                    val0->d, val1->d, &res->d)) {
+        return;
+    }
     res->d = floatx80_mul(val0->d, val1->d, &env->fp_status);
 }
 
 void HELPER(fsmul)(CPUM68KState *env, FPReg *res, FPReg *val0, FPReg *val1)
 {
+    if (fpu_fast_op(env, 32, FPU_OP_MUL, val0->d, val1->d, &res->d)) {
+        return;
+    }
     PREC_BEGIN(32);
     res->d = floatx80_mul(val0->d, val1->d, &env->fp_status);
     PREC_END();
@@ -355,6 +582,9 @@ void HELPER(fsmul)(CPUM68KState *env, FPReg *res, FPReg *val0, FPReg *val1)
 
 void HELPER(fdmul)(CPUM68KState *env, FPReg *res, FPReg *val0, FPReg *val1)
 {
+    if (fpu_fast_op(env, 64, FPU_OP_MUL, val0->d, val1->d, &res->d)) {
+        return;
+    }
     PREC_BEGIN(64);
     res->d = floatx80_mul(val0->d, val1->d, &env->fp_status);
     PREC_END();
@@ -376,11 +606,18 @@ void HELPER(fsglmul)(CPUM68KState *env, FPReg *res, FPReg *val0, FPReg *val1)
 
 void HELPER(fdiv)(CPUM68KState *env, FPReg *res, FPReg *val0, FPReg *val1)
 {
+    if (fpu_fast_op(env, fpu_prec(env), FPU_OP_DIV,
+                    val1->d, val0->d, &res->d)) {
+        return;
+    }
     res->d = floatx80_div(val1->d, val0->d, &env->fp_status);
 }
 
 void HELPER(fsdiv)(CPUM68KState *env, FPReg *res, FPReg *val0, FPReg *val1)
 {
+    if (fpu_fast_op(env, 32, FPU_OP_DIV, val1->d, val0->d, &res->d)) {
+        return;
+    }
     PREC_BEGIN(32);
     res->d = floatx80_div(val1->d, val0->d, &env->fp_status);
     PREC_END();
@@ -388,6 +625,9 @@ void HELPER(fsdiv)(CPUM68KState *env, FPReg *res, FPReg *val0, FPReg *val1)
 
 void HELPER(fddiv)(CPUM68KState *env, FPReg *res, FPReg *val0, FPReg *val1)
 {
+    if (fpu_fast_op(env, 64, FPU_OP_DIV, val1->d, val0->d, &res->d)) {
+        return;
+    }
     PREC_BEGIN(64);
     res->d = floatx80_div(val1->d, val0->d, &env->fp_status);
     PREC_END();
@@ -423,7 +663,7 @@ static int float_comp_to_cc(int float_compare)
     }
 }
 
-void HELPER(fcmp)(CPUM68KState *env, FPReg *val0, FPReg *val1)
+uint32_t HELPER(fcmp)(CPUM68KState *env, FPReg *val0, FPReg *val1)
 {
     int flags, float_compare;
     uint32_t fpsr;
@@ -436,25 +676,37 @@ void HELPER(fcmp)(CPUM68KState *env, FPReg *val0, FPReg *val1)
         fpu_exception(env, FPSR_ES_OPERR);
     }
     env->fpsr = set_fpsr_exception(env, fpsr);
+
+    return float_compare;
 }
 
-void HELPER(ftst)(CPUM68KState *env, FPReg *val)
+/* Sets the FPSR condition codes from VAL, and returns the float_relation
+   of VAL to zero that the translator uses for FBcc and FScc.  */
+uint32_t HELPER(ftst)(CPUM68KState *env, FPReg *val)
 {
     uint32_t cc = 0;
+    int rel;
 
     if (floatx80_is_neg(val->d)) {
         cc |= FPSR_CC_N;
+        rel = float_relation_less;
+    } else {
+        rel = float_relation_greater;
     }
 
     if (floatx80_is_any_nan(val->d)) {
         cc |= FPSR_CC_A;
+        rel = float_relation_unordered;
     } else if (floatx80_is_infinity(val->d)) {
         cc |= FPSR_CC_I;
     } else if (floatx80_is_zero(val->d)) {
         cc |= FPSR_CC_Z;
+        rel = float_relation_equal;
     }
 
     env->fpsr = set_fpsr_exception(env, (env->fpsr & ~FPSR_CC_MASK) | cc);
+
+    return rel;
 }
 
 void cpu_m68k_set_fpsr(CPUM68KState *env, uint32_t val)
@@ -502,123 +754,157 @@ void HELPER(fconst)(CPUM68KState *env, FPReg *val, uint32_t offset)
     val->d = fpu_rom[offset];
 }
 
-typedef int (*float_access)(CPUM68KState *env, uint32_t addr, FPReg *fp,
-                            uintptr_t ra);
+/* Transfer one register.  HOST is a direct pointer to the guest memory
+   at ADDR, or NULL if the cpu_ld/st accessors must be used.  */
+typedef void (*float_access)(CPUM68KState *env, uint32_t addr, uint8_t *host,
+                             FPReg *fp, uintptr_t ra);
 
 static uint32_t fmovem_predec(CPUM68KState *env, uint32_t addr, uint32_t mask,
-                               float_access access)
+                              int size, float_access access, uintptr_t ra)
 {
-    uintptr_t ra = GETPC();
-    int i, size;
+    int n = ctpop8(mask);
+    uint8_t *host;
+    int i;
 
+    /* The registers are stored at decreasing addresses from ADDR.  */
+    host = m68k_bulk_access_begin(env, addr - (n - 1) * size, n * size,
+                                  MMU_DATA_STORE, ra);
+    if (host) {
+        host += (n - 1) * size;
+    }
     for (i = 7; i >= 0; i--, mask <<= 1) {
         if (mask & 0x80) {
-            size = access(env, addr, &env->fregs[i], ra);
+            access(env, addr, host, &env->fregs[i], ra);
             if ((mask & 0xff) != 0x80) {
                 addr -= size;
+                if (host) {
+                    host -= size;
+                }
             }
         }
     }
+    m68k_bulk_access_end();
 
     return addr;
 }
 
 static uint32_t fmovem_postinc(CPUM68KState *env, uint32_t addr, uint32_t mask,
-                               float_access access)
+                               int size, MMUAccessType access_type,
+                               float_access access, uintptr_t ra)
 {
-    uintptr_t ra = GETPC();
-    int i, size;
+    uint8_t *host;
+    int i;
 
+    host = m68k_bulk_access_begin(env, addr, ctpop8(mask) * size,
+                                  access_type, ra);
     for (i = 0; i < 8; i++, mask <<= 1) {
         if (mask & 0x80) {
-            size = access(env, addr, &env->fregs[i], ra);
+            access(env, addr, host, &env->fregs[i], ra);
             addr += size;
+            if (host) {
+                host += size;
+            }
         }
     }
+    m68k_bulk_access_end();
 
     return addr;
 }
 
-static int cpu_ld_floatx80_ra(CPUM68KState *env, uint32_t addr, FPReg *fp,
-                              uintptr_t ra)
+static void cpu_ld_floatx80_ra(CPUM68KState *env, uint32_t addr,
+                               uint8_t *host, FPReg *fp, uintptr_t ra)
 {
     uint32_t high;
     uint64_t low;
 
-    high = cpu_ldl_data_ra(env, addr, ra);
-    low = cpu_ldq_data_ra(env, addr + 4, ra);
+    if (host) {
+        high = ldl_be_p(host);
+        low = ldq_be_p(host + 4);
+    } else {
+        high = cpu_ldl_data_ra(env, addr, ra);
+        low = cpu_ldq_data_ra(env, addr + 4, ra);
+    }
 
     fp->l.upper = high >> 16;
     fp->l.lower = low;
-
-    return 12;
 }
 
-static int cpu_st_floatx80_ra(CPUM68KState *env, uint32_t addr, FPReg *fp,
-                               uintptr_t ra)
+static void cpu_st_floatx80_ra(CPUM68KState *env, uint32_t addr,
+                               uint8_t *host, FPReg *fp, uintptr_t ra)
 {
-    cpu_stl_data_ra(env, addr, fp->l.upper << 16, ra);
-    cpu_stq_data_ra(env, addr + 4, fp->l.lower, ra);
-
-    return 12;
+    if (host) {
+        stl_be_p(host, fp->l.upper << 16);
+        stq_be_p(host + 4, fp->l.lower);
+    } else {
+        cpu_stl_data_ra(env, addr, fp->l.upper << 16, ra);
+        cpu_stq_data_ra(env, addr + 4, fp->l.lower, ra);
+    }
 }
 
-static int cpu_ld_float64_ra(CPUM68KState *env, uint32_t addr, FPReg *fp,
-                             uintptr_t ra)
+static void cpu_ld_float64_ra(CPUM68KState *env, uint32_t addr,
+                              uint8_t *host, FPReg *fp, uintptr_t ra)
 {
     uint64_t val;
 
-    val = cpu_ldq_data_ra(env, addr, ra);
+    if (host) {
+        val = ldq_be_p(host);
+    } else {
+        val = cpu_ldq_data_ra(env, addr, ra);
+    }
     fp->d = float64_to_floatx80(*(float64 *)&val, &env->fp_status);
-
-    return 8;
 }
 
-static int cpu_st_float64_ra(CPUM68KState *env, uint32_t addr, FPReg *fp,
-                             uintptr_t ra)
+static void cpu_st_float64_ra(CPUM68KState *env, uint32_t addr,
+                              uint8_t *host, FPReg *fp, uintptr_t ra)
 {
     float64 val;
 
     val = floatx80_to_float64(fp->d, &env->fp_status);
-    cpu_stq_data_ra(env, addr, *(uint64_t *)&val, ra);
-
-    return 8;
+    if (host) {
+        stq_be_p(host, *(uint64_t *)&val);
+    } else {
+        cpu_stq_data_ra(env, addr, *(uint64_t *)&val, ra);
+    }
 }
 
 uint32_t HELPER(fmovemx_st_predec)(CPUM68KState *env, uint32_t addr,
                                    uint32_t mask)
 {
-    return fmovem_predec(env, addr, mask, cpu_st_floatx80_ra);
+    return fmovem_predec(env, addr, mask, 12, cpu_st_floatx80_ra, GETPC());
 }
 
 uint32_t HELPER(fmovemx_st_postinc)(CPUM68KState *env, uint32_t addr,
                                     uint32_t mask)
 {
-    return fmovem_postinc(env, addr, mask, cpu_st_floatx80_ra);
+    return fmovem_postinc(env, addr, mask, 12, MMU_DATA_STORE,
+                          cpu_st_floatx80_ra, GETPC());
 }
 
 uint32_t HELPER(fmovemx_ld_postinc)(CPUM68KState *env, uint32_t addr,
                                     uint32_t mask)
 {
-    return fmovem_postinc(env, addr, mask, cpu_ld_floatx80_ra);
+    return fmovem_postinc(env, addr, mask, 12, MMU_DATA_LOAD,
+                          cpu_ld_floatx80_ra, GETPC());
 }
 
 uint32_t HELPER(fmovemd_st_predec)(CPUM68KState *env, uint32_t addr,
                                    uint32_t mask)
 {
-    return fmovem_predec(env, addr, mask, cpu_st_float64_ra);
+    return fmovem_predec(env, addr, mask, 8, cpu_st_float64_ra, GETPC());
 }
 
 uint32_t HELPER(fmovemd_st_postinc)(CPUM68KState *env, uint32_t addr,
                                     uint32_t mask)
 {
-    return fmovem_postinc(env, addr, mask, cpu_st_float64_ra);
+    return fmovem_postinc(env, addr, mask, 8, MMU_DATA_STORE,
+                          cpu_st_float64_ra, GETPC());
 }
 
 uint32_t HELPER(fmovemd_ld_postinc)(CPUM68KState *env, uint32_t addr,
                                     uint32_t mask)
 {
-    return fmovem_postinc(env, addr, mask, cpu_ld_float64_ra);
+    return fmovem_postinc(env, addr, mask, 8, MMU_DATA_LOAD,
+                          cpu_ld_float64_ra, GETPC());
 }
 
 static void make_quotient(CPUM68KState *env, floatx80 val)
@@ -671,96 +957,155 @@ void HELPER(fscale)(CPUM68KState *env, FPReg *res, FPReg *val0, FPReg *val1)
 
 void HELPER(flognp1)(CPUM68KState *env, FPReg *res, FPReg *val)
 {
+    if (fpu_fast_func(env, FPU_FUNC_LOGNP1, val->d, &res->d)) {
+        return;
+    }
     res->d = floatx80_lognp1(val->d, &env->fp_status);
 }
 
 void HELPER(flogn)(CPUM68KState *env, FPReg *res, FPReg *val)
 {
+    if (fpu_fast_func(env, FPU_FUNC_LOGN, val->d, &res->d)) {
+        return;
+    }
     res->d = floatx80_logn(val->d, &env->fp_status);
 }
 
 void HELPER(flog10)(CPUM68KState *env, FPReg *res, FPReg *val)
 {
+    if (fpu_fast_func(env, FPU_FUNC_LOG10, val->d, &res->d)) {
+        return;
+    }
     res->d = floatx80_log10(val->d, &env->fp_status);
 }
 
 void HELPER(flog2)(CPUM68KState *env, FPReg *res, FPReg *val)
 {
+    if (fpu_fast_func(env, FPU_FUNC_LOG2, val->d, &res->d)) {
+        return;
+    }
     res->d = floatx80_log2(val->d, &env->fp_status);
 }
 
 void HELPER(fetox)(CPUM68KState *env, FPReg *res, FPReg *val)
 {
+    if (fpu_fast_func(env, FPU_FUNC_ETOX, val->d, &res->d)) {
+        return;
+    }
     res->d = floatx80_etox(val->d, &env->fp_status);
 }
 
 void HELPER(ftwotox)(CPUM68KState *env, FPReg *res, FPReg *val)
 {
+    if (fpu_fast_func(env, FPU_FUNC_TWOTOX, val->d, &res->d)) {
+        return;
+    }
     res->d = floatx80_twotox(val->d, &env->fp_status);
 }
 
 void HELPER(ftentox)(CPUM68KState *env, FPReg *res, FPReg *val)
 {
+    if (fpu_fast_func(env, FPU_FUNC_TENTOX, val->d, &res->d)) {
+        return;
+    }
     res->d = floatx80_tentox(val->d, &env->fp_status);
 }
 
 void HELPER(ftan)(CPUM68KState *env, FPReg *res, FPReg *val)
 {
+    if (fpu_fast_func(env, FPU_FUNC_TAN, val->d, &res->d)) {
+        return;
+    }
     res->d = floatx80_tan(val->d, &env->fp_status);
 }
 
 void HELPER(fsin)(CPUM68KState *env, FPReg *res, FPReg *val)
 {
+    if (fpu_fast_func(env, FPU_FUNC_SIN, val->d, &res->d)) {
+        return;
+    }
     res->d = floatx80_sin(val->d, &env->fp_status);
 }
 
 void HELPER(fcos)(CPUM68KState *env, FPReg *res, FPReg *val)
 {
+    if (fpu_fast_func(env, FPU_FUNC_COS, val->d, &res->d)) {
+        return;
+    }
     res->d = floatx80_cos(val->d, &env->fp_status);
 }
 
 void HELPER(fsincos)(CPUM68KState *env, FPReg *res0, FPReg *res1, FPReg *val)
 {
     floatx80 a = val->d;
+    floatx80 s, c;
+
     /* If res0 and res1 specify the same floating-point data register,
      * the sine result is stored in the register, and the cosine
      * result is discarded.
      */
+    if (fpu_fast_func(env, FPU_FUNC_COS, a, &c) &&
+        fpu_fast_func(env, FPU_FUNC_SIN, a, &s)) {
+        res1->d = c;
+        res0->d = s;
+        return;
+    }
     res1->d = floatx80_cos(a, &env->fp_status);
     res0->d = floatx80_sin(a, &env->fp_status);
 }
 
 void HELPER(fatan)(CPUM68KState *env, FPReg *res, FPReg *val)
 {
+    if (fpu_fast_func(env, FPU_FUNC_ATAN, val->d, &res->d)) {
+        return;
+    }
     res->d = floatx80_atan(val->d, &env->fp_status);
 }
 
 void HELPER(fasin)(CPUM68KState *env, FPReg *res, FPReg *val)
 {
+    if (fpu_fast_func(env, FPU_FUNC_ASIN, val->d, &res->d)) {
+        return;
+    }
     res->d = floatx80_asin(val->d, &env->fp_status);
 }
 
 void HELPER(facos)(CPUM68KState *env, FPReg *res, FPReg *val)
 {
+    if (fpu_fast_func(env, FPU_FUNC_ACOS, val->d, &res->d)) {
+        return;
+    }
     res->d = floatx80_acos(val->d, &env->fp_status);
 }
 
 void HELPER(fatanh)(CPUM68KState *env, FPReg *res, FPReg *val)
 {
+    if (fpu_fast_func(env, FPU_FUNC_ATANH, val->d, &res->d)) {
+        return;
+    }
     res->d = floatx80_atanh(val->d, &env->fp_status);
 }
 
 void HELPER(ftanh)(CPUM68KState *env, FPReg *res, FPReg *val)
 {
+    if (fpu_fast_func(env, FPU_FUNC_TANH, val->d, &res->d)) {
+        return;
+    }
     res->d = floatx80_tanh(val->d, &env->fp_status);
 }
 
 void HELPER(fsinh)(CPUM68KState *env, FPReg *res, FPReg *val)
 {
+    if (fpu_fast_func(env, FPU_FUNC_SINH, val->d, &res->d)) {
+        return;
+    }
     res->d = floatx80_sinh(val->d, &env->fp_status);
 }
 
 void HELPER(fcosh)(CPUM68KState *env, FPReg *res, FPReg *val)
 {
+    if (fpu_fast_func(env, FPU_FUNC_COSH, val->d, &res->d)) {
+        return;
+    }
     res->d = floatx80_cosh(val->d, &env->fp_status);
 }
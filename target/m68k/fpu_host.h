@@ -0,0 +1,521 @@
+/*
+ * m68k FPU host fast path
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Evaluation of floatx80 operations rounded to single or double
+ * precision on the host FPU, in round-to-nearest mode.  These functions
+ * only depend on softfloat types, so that tests/test-m68k-fpu-host.c can
+ * check them against softfloat; fpu_helper.c decides when to use them.
+ *
+ * An arithmetic operation on operands exactly representable in the host
+ * format produces the same bits on the host FPU as in the floatx80 code
+ * (floatx80 keeps its extended exponent range when the rounding
+ * precision is reduced, so the result must also be a normal number in
+ * the host format).  Operands and results are further kept away from
+ * the underflow and overflow thresholds, so that the rounding error of
+ * the operation can be computed exactly: this gives the inexact flag,
+ * the only one such an operation can raise.
+ */
+
+#ifndef TARGET_M68K_FPU_HOST_H
+#define TARGET_M68K_FPU_HOST_H
+
+#include <math.h>
+#include <float.h>
+#include "fpu/softfloat.h"
+
+typedef enum {
+    FPU_OP_ADD,
+    FPU_OP_SUB,
+    FPU_OP_MUL,
+    FPU_OP_DIV,
+    FPU_OP_SQRT,
+} FPUOp;
+
+typedef enum {
+    FPU_FUNC_SIN,
+    FPU_FUNC_COS,
+    FPU_FUNC_TAN,
+    FPU_FUNC_ASIN,
+    FPU_FUNC_ACOS,
+    FPU_FUNC_ATAN,
+    FPU_FUNC_SINH,
+    FPU_FUNC_COSH,
+    FPU_FUNC_TANH,
+    FPU_FUNC_ATANH,
+    FPU_FUNC_ETOX,
+    FPU_FUNC_TWOTOX,
+    FPU_FUNC_TENTOX,
+    FPU_FUNC_LOGN,
+    FPU_FUNC_LOGNP1,
+    FPU_FUNC_LOG10,
+    FPU_FUNC_LOG2,
+} FPUFunc;
+
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+static inline bool floatx80_to_host_double(floatx80 a, double *d)
+{
+    union {
+        double d;
+        uint64_t i;
+    } u;
+    int exp = a.high & 0x7fff;
+
+    if (exp == 0 && a.low == 0) {
+        u.i = 0;
+    } else {
+        exp = exp - 0x3fff + 0x3ff;
+        if (!(a.low & (1ULL << 63)) || exp <= 0 || exp >= 0x7ff ||
+            (a.low & 0x7ff)) {
+            return false;
+        }
+        u.i = ((uint64_t)exp << 52) | ((a.low >> 11) & ((1ULL << 52) - 1));
+    }
+    u.i |= (uint64_t)(a.high >> 15) << 63;
+    *d = u.d;
+    return true;
+}
+
+static inline floatx80 host_double_to_floatx80(double d)
+{
+    union {
+        double d;
+        uint64_t i;
+    } u = { .d = d };
+    uint16_t sign = (u.i >> 63) << 15;
+    int exp = (u.i >> 52) & 0x7ff;
+
+    if (exp == 0) {
+        return make_floatx80(sign, 0);
+    }
+    return make_floatx80(sign | (exp - 0x3ff + 0x3fff),
+                         (1ULL << 63) | ((u.i & ((1ULL << 52) - 1)) << 11));
+}
+
+static inline bool floatx80_to_host_float(floatx80 a, float *f)
+{
+    union {
+        float f;
+        uint32_t i;
+    } u;
+    int exp = a.high & 0x7fff;
+
+    if (exp == 0 && a.low == 0) {
+        u.i = 0;
+    } else {
+        exp = exp - 0x3fff + 0x7f;
+        if (!(a.low & (1ULL << 63)) || exp <= 0 || exp >= 0xff ||
+            (a.low & ((1ULL << 40) - 1))) {
+            return false;
+        }
+        u.i = (exp << 23) | ((a.low >> 40) & ((1 << 23) - 1));
+    }
+    u.i |= (uint32_t)(a.high >> 15) << 31;
+    *f = u.f;
+    return true;
+}
+
+static inline floatx80 host_float_to_floatx80(float f)
+{
+    union {
+        float f;
+        uint32_t i;
+    } u = { .f = f };
+    uint16_t sign = (u.i >> 31) << 15;
+    int exp = (u.i >> 23) & 0xff;
+
+    if (exp == 0) {
+        return make_floatx80(sign, 0);
+    }
+    return make_floatx80(sign | (exp - 0x7f + 0x3fff),
+                         (1ULL << 63) |
+                         ((uint64_t)(u.i & ((1 << 23) - 1)) << 40));
+}
+
+/* Magnitudes for which the rounding error of an operation is exactly
+ * representable and the computations below cannot overflow.  Single
+ * precision errors are computed in double, so there the results only
+ * have to stay normal.
+ */
+#define FPU_HOST_F64_MIN (DBL_MIN * (1ULL << 53) * (1ULL << 53))
+#define FPU_HOST_F64_MAX (DBL_MAX / 4)
+#define FPU_HOST_F32_MIN (2 * FLT_MIN)
+#define FPU_HOST_F32_MAX (FLT_MAX / 4)
+
+static inline bool fpu_host_f64_safe(double d)
+{
+    return d == 0 || (fabs(d) >= FPU_HOST_F64_MIN &&
+                      fabs(d) <= FPU_HOST_F64_MAX);
+}
+
+static inline bool fpu_host_f32_safe(float f)
+{
+    return f == 0 || (fabsf(f) >= FPU_HOST_F32_MIN &&
+                      fabsf(f) <= FPU_HOST_F32_MAX);
+}
+
+/* The rounding error of S = A + B (Knuth's TwoSum).  */
+static inline double fpu_host_sum_err(double a, double b, double s)
+{
+    double bb = s - a;
+
+    return (a - (s - bb)) + (b - bb);
+}
+
+static inline float fpu_host_sum_errf(float a, float b, float s)
+{
+    float bb = s - a;
+
+    return (a - (s - bb)) + (b - bb);
+}
+
+/* Compute A op B (or sqrt(A)) rounded to double precision, and whether
+   it is inexact.  Return false if softfloat must be used instead.  */
+static inline bool fpu_fast_op_f64(FPUOp op, floatx80 a, floatx80 b,
+                                   floatx80 *res, bool *inexact)
+{
+    double da, db = 0, dr, err;
+    bool exact_zero;
+
+    if (!floatx80_to_host_double(a, &da) || !fpu_host_f64_safe(da) ||
+        (op != FPU_OP_SQRT &&
+         (!floatx80_to_host_double(b, &db) || !fpu_host_f64_safe(db)))) {
+        return false;
+    }
+    switch (op) {
+    case FPU_OP_ADD:
+        dr = da + db;
+        err = fpu_host_sum_err(da, db, dr);
+        /* With gradual underflow a zero sum is always exact.  */
+        exact_zero = true;
+        break;
+    case FPU_OP_SUB:
+        dr = da - db;
+        err = fpu_host_sum_err(da, -db, dr);
+        exact_zero = true;
+        break;
+    case FPU_OP_MUL:
+        dr = da * db;
+        err = fma(da, db, -dr);
+        exact_zero = da == 0 || db == 0;
+        break;
+    case FPU_OP_DIV:
+        if (db == 0) {
+            return false;
+        }
+        dr = da / db;
+        err = fma(-dr, db, da);
+        exact_zero = da == 0;
+        break;
+    case FPU_OP_SQRT:
+        if (da < 0) {
+            return false;
+        }
+        dr = sqrt(da);
+        err = fma(-dr, dr, da);
+        exact_zero = da == 0;
+        break;
+    default:
+        g_assert_not_reached();
+    }
+    if (dr == 0 ? !exact_zero : !fpu_host_f64_safe(dr)) {
+        return false;
+    }
+    *res = host_double_to_floatx80(dr);
+    *inexact = err != 0;
+    return true;
+}
+
+/* Likewise in single precision.  The products of two floats, and their
+   differences with a nearby float, are exact in double precision.  */
+static inline bool fpu_fast_op_f32(FPUOp op, floatx80 a, floatx80 b,
+                                   floatx80 *res, bool *inexact)
+{
+    float fa, fb = 0, fr;
+    double err;
+    bool exact_zero;
+
+    if (!floatx80_to_host_float(a, &fa) || !fpu_host_f32_safe(fa) ||
+        (op != FPU_OP_SQRT &&
+         (!floatx80_to_host_float(b, &fb) || !fpu_host_f32_safe(fb)))) {
+        return false;
+    }
+    switch (op) {
+    case FPU_OP_ADD:
+        fr = fa + fb;
+        err = fpu_host_sum_errf(fa, fb, fr);
+        /* With gradual underflow a zero sum is always exact.  */
+        exact_zero = true;
+        break;
+    case FPU_OP_SUB:
+        fr = fa - fb;
+        err = fpu_host_sum_errf(fa, -fb, fr);
+        exact_zero = true;
+        break;
+    case FPU_OP_MUL:
+        fr = fa * fb;
+        err = (double)fa * fb - fr;
+        exact_zero = fa == 0 || fb == 0;
+        break;
+    case FPU_OP_DIV:
+        if (fb == 0) {
+            return false;
+        }
+        fr = fa / fb;
+        err = fa - (double)fr * fb;
+        exact_zero = fa == 0;
+        break;
+    case FPU_OP_SQRT:
+        if (fa < 0) {
+            return false;
+        }
+        fr = sqrtf(fa);
+        err = fa - (double)fr * fr;
+        exact_zero = fa == 0;
+        break;
+    default:
+        g_assert_not_reached();
+    }
+    if (fr == 0 ? !exact_zero : !fpu_host_f32_safe(fr)) {
+        return false;
+    }
+    *res = host_float_to_floatx80(fr);
+    *inexact = err != 0;
+    return true;
+}
+
+/* The transcendental functions are evaluated by the host libm, in double
+ * for a single precision result and in long double for a double
+ * precision one.  The host value is only used when an interval of
+ * relative width 2^-45 (resp. 2^-59) around it, which is far wider than
+ * the libm error, rounds to a single target value: that value is then
+ * the correctly rounded result.  The FPSP code in softfloat is not always
+ * correctly rounded, and sin and cos lose more bits near a large multiple
+ * of pi, so the two can differ.
+ *
+ * Zero, special and out of range operands or results go through the
+ * FPSP code, and so do the few cases where the result can be exact:
+ * 2^n and 10^n for an integer n, log2 and log10 of their powers.  Every
+ * other result is inexact.
+ *
+ * Where long double is no wider than double, double precision results
+ * always use the FPSP code.  Note that on aarch64 long double is a
+ * software-emulated IEEE quad, and on ppc64 a software double-double or
+ * quad depending on the ABI, so there the double precision fast path
+ * trades one software implementation for another.
+ */
+#define FPU_FUNC_ERR_F32 (1.0 / (1ULL << 45))
+#define FPU_FUNC_ERR_F64 (1.0L / (1ULL << 59))
+
+/* Whether FUNC(X), which rounds to R, may be exact.  */
+static inline bool fpu_host_func_maybe_exact(FPUFunc func, double x,
+                                             double r)
+{
+    switch (func) {
+    case FPU_FUNC_TWOTOX:
+    case FPU_FUNC_TENTOX:
+        return x == trunc(x);
+    case FPU_FUNC_LOG2:
+    case FPU_FUNC_LOG10:
+        return r == trunc(r);
+    default:
+        return false;
+    }
+}
+
+static inline double fpu_host_func(FPUFunc func, double x)
+{
+    switch (func) {
+    case FPU_FUNC_SIN:
+        return sin(x);
+    case FPU_FUNC_COS:
+        return cos(x);
+    case FPU_FUNC_TAN:
+        return tan(x);
+    case FPU_FUNC_ASIN:
+        return asin(x);
+    case FPU_FUNC_ACOS:
+        return acos(x);
+    case FPU_FUNC_ATAN:
+        return atan(x);
+    case FPU_FUNC_SINH:
+        return sinh(x);
+    case FPU_FUNC_COSH:
+        return cosh(x);
+    case FPU_FUNC_TANH:
+        return tanh(x);
+    case FPU_FUNC_ATANH:
+        return atanh(x);
+    case FPU_FUNC_ETOX:
+        return exp(x);
+    case FPU_FUNC_TWOTOX:
+        return exp2(x);
+    case FPU_FUNC_TENTOX:
+        return pow(10, x);
+    case FPU_FUNC_LOGN:
+        return log(x);
+    case FPU_FUNC_LOGNP1:
+        return log1p(x);
+    case FPU_FUNC_LOG10:
+        return log10(x);
+    case FPU_FUNC_LOG2:
+        return log2(x);
+    default:
+        g_assert_not_reached();
+    }
+}
+
+/* Compute FUNC(A) rounded to single precision.  The result is inexact.
+   Return false if the FPSP code must be used instead.  */
+static inline bool fpu_fast_func_f32(FPUFunc func, floatx80 a, floatx80 *res)
+{
+    double da, dr, err;
+    float lo, hi;
+
+    if (!floatx80_to_host_double(a, &da) || da == 0) {
+        return false;
+    }
+    dr = fpu_host_func(func, da);
+    if (!isfinite(dr)) {
+        return false;
+    }
+    err = fabs(dr) * FPU_FUNC_ERR_F32;
+    lo = dr - err;
+    hi = dr + err;
+    if (lo != hi || !(fabsf(lo) >= 2 * FLT_MIN && fabsf(lo) <= FLT_MAX) ||
+        fpu_host_func_maybe_exact(func, da, lo)) {
+        return false;
+    }
+    *res = host_float_to_floatx80(lo);
+    return true;
+}
+
+#if LDBL_MANT_DIG >= 64
+static inline long double fpu_host_funcl(FPUFunc func, long double x)
+{
+    switch (func) {
+    case FPU_FUNC_SIN:
+        return sinl(x);
+    case FPU_FUNC_COS:
+        return cosl(x);
+    case FPU_FUNC_TAN:
+        return tanl(x);
+    case FPU_FUNC_ASIN:
+        return asinl(x);
+    case FPU_FUNC_ACOS:
+        return acosl(x);
+    case FPU_FUNC_ATAN:
+        return atanl(x);
+    case FPU_FUNC_SINH:
+        return sinhl(x);
+    case FPU_FUNC_COSH:
+        return coshl(x);
+    case FPU_FUNC_TANH:
+        return tanhl(x);
+    case FPU_FUNC_ATANH:
+        return atanhl(x);
+    case FPU_FUNC_ETOX:
+        return expl(x);
+    case FPU_FUNC_TWOTOX:
+        return exp2l(x);
+    case FPU_FUNC_TENTOX:
+        return powl(10, x);
+    case FPU_FUNC_LOGN:
+        return logl(x);
+    case FPU_FUNC_LOGNP1:
+        return log1pl(x);
+    case FPU_FUNC_LOG10:
+        return log10l(x);
+    case FPU_FUNC_LOG2:
+        return log2l(x);
+    default:
+        g_assert_not_reached();
+    }
+}
+
+/* The 64-bit significand of a normal floatx80 fits in the long double
+   significand, provided the exponent stays within its normal range.  */
+static inline bool floatx80_to_host_ldouble(floatx80 a, long double *ld)
+{
+    int exp = (a.high & 0x7fff) - 0x3fff;
+
+    if (!(a.low & (1ULL << 63)) || (a.high & 0x7fff) == 0 ||
+        exp < LDBL_MIN_EXP + 63 || exp >= LDBL_MAX_EXP) {
+        return false;
+    }
+    *ld = ldexpl(a.low, exp - 63);
+    if (a.high & 0x8000) {
+        *ld = -*ld;
+    }
+    return true;
+}
+
+/* Likewise in double precision.  */
+static inline bool fpu_fast_func_f64(FPUFunc func, floatx80 a, floatx80 *res)
+{
+    long double la, lr, err;
+    double lo, hi;
+
+    if (!floatx80_to_host_ldouble(a, &la)) {
+        return false;
+    }
+    lr = fpu_host_funcl(func, la);
+    if (!isfinite(lr)) {
+        return false;
+    }
+    err = fabsl(lr) * FPU_FUNC_ERR_F64;
+    lo = lr - err;
+    hi = lr + err;
+    if (lo != hi || !(fabs(lo) >= 2 * DBL_MIN && fabs(lo) <= DBL_MAX) ||
+        fpu_host_func_maybe_exact(func, la, lo)) {
+        return false;
+    }
+    *res = host_double_to_floatx80(lo);
+    return true;
+}
+#else
+static inline bool fpu_fast_func_f64(FPUFunc func, floatx80 a, floatx80 *res)
+{
+    return false;
+}
+#endif
+#else
+/* The host evaluates float and double expressions in a wider format,
+   which would round twice.  */
+static inline bool fpu_fast_op_f64(FPUOp op, floatx80 a, floatx80 b,
+                                   floatx80 *res, bool *inexact)
+{
+    return false;
+}
+
+static inline bool fpu_fast_op_f32(FPUOp op, floatx80 a, floatx80 b,
+                                   floatx80 *res, bool *inexact)
+{
+    return false;
+}
+
+static inline bool fpu_fast_func_f32(FPUFunc func, floatx80 a, floatx80 *res)
+{
+    return false;
+}
+
+static inline bool fpu_fast_func_f64(FPUFunc func, floatx80 a, floatx80 *res)
+{
+    return false;
+}
+#endif
+
+#endif
@@ -171,10 +171,19 @@ void m68k_cpu_init_gdb(M68kCPU *cpu)
     /* TODO: Add [E]MAC registers.  */
 }
 
-void HELPER(movec)(CPUM68KState *env, uint32_t reg, uint32_t val)
+/* MOVEC of a control register the CPU does not have is an illegal
+   instruction.  */
+static void QEMU_NORETURN m68k_movec_illegal(CPUM68KState *env,
+                                             uintptr_t ra)
 {
-    M68kCPU *cpu = m68k_env_get_cpu(env);
+    CPUState *cs = CPU(m68k_env_get_cpu(env));
+
+    cs->exception_index = EXCP_ILLEGAL;
+    cpu_loop_exit_restore(cs, ra);
+}
 
+void HELPER(movec)(CPUM68KState *env, uint32_t reg, uint32_t val)
+{
     switch (reg) {
     case 0x02: /* CACR */
         env->cacr = val;
@@ -188,11 +197,139 @@ void HELPER(movec)(CPUM68KState *env, uint32_t reg, uint32_t val)
         break;
     /* TODO: Implement control registers.  */
     default:
-        cpu_abort(CPU(cpu), "Unimplemented control register write 0x%x = 0x%x\n",
-                  reg, val);
+        m68k_movec_illegal(env, GETPC());
     }
 }
 
+static void m68k_flush_atc(CPUM68KState *env)
+{
+    memset(env->atc, 0, sizeof(env->atc));
+}
+
+void HELPER(m68k_movec_to)(CPUM68KState *env, uint32_t reg, uint32_t val)
+{
+    M68kCPU *cpu = m68k_env_get_cpu(env);
+    CPUState *cs = CPU(cpu);
+
+    switch (reg) {
+    case 0x000: /* SFC */
+        env->sfc = val & 7;
+        return;
+    case 0x001: /* DFC */
+        env->dfc = val & 7;
+        return;
+    case 0x002: /* CACR */
+        env->cacr = val;
+        m68k_switch_sp(env);
+        return;
+    case 0x800: /* USP */
+        env->sp[M68K_USP] = val;
+        return;
+    case 0x801: /* VBR */
+        env->vbr = val;
+        return;
+    }
+    if (!m68k_feature(env, M68K_FEATURE_M68060)) {
+        switch (reg) {
+        case 0x803: /* MSP */
+            env->msp = val;
+            return;
+        case 0x804: /* ISP */
+            /* MOVEC is privileged, so the interrupt stack is the
+               current one.  */
+            env->aregs[7] = val;
+            return;
+        }
+    }
+    if (m68k_feature(env, M68K_FEATURE_M68040_MMU)) {
+        switch (reg) {
+        case 0x003: /* TC */
+            env->mmu.tcr = val & (M68K_TCR_ENABLED | M68K_TCR_PAGE_8K);
+            m68k_flush_atc(env);
+            tlb_flush(cs);
+            return;
+        case 0x004: case 0x005: /* ITT0, ITT1 */
+        case 0x006: case 0x007: /* DTT0, DTT1 */
+            env->mmu.ttr[reg - 0x004] = val;
+            tlb_flush(cs);
+            return;
+        case 0x805: /* MMUSR */
+            env->mmu.mmusr = val;
+            return;
+        case 0x806: /* URP */
+            /* The ATC is tagged with the root pointer, only the softmmu
+               TLB has to go.  */
+            env->mmu.urp = val;
+            tlb_flush_by_mmuidx(cs, 1 << MMU_USER_IDX);
+            return;
+        case 0x807: /* SRP */
+            env->mmu.srp = val;
+            tlb_flush_by_mmuidx(cs, 1 << MMU_KERNEL_IDX);
+            return;
+        }
+    }
+    if (m68k_feature(env, M68K_FEATURE_M68060)) {
+        switch (reg) {
+        case 0x008: /* BUSCR */
+            env->buscr = val & 0xf0000000;
+            return;
+        case 0x808: /* PCR */
+            /* DFP and ESS are stored but have no effect.  */
+            env->pcr = val & M68K_PCR_WRITABLE;
+            return;
+        }
+    }
+    m68k_movec_illegal(env, GETPC());
+}
+
+uint32_t HELPER(m68k_movec_from)(CPUM68KState *env, uint32_t reg)
+{
+    switch (reg) {
+    case 0x000: /* SFC */
+        return env->sfc;
+    case 0x001: /* DFC */
+        return env->dfc;
+    case 0x002: /* CACR */
+        return env->cacr;
+    case 0x800: /* USP */
+        return env->sp[M68K_USP];
+    case 0x801: /* VBR */
+        return env->vbr;
+    }
+    if (!m68k_feature(env, M68K_FEATURE_M68060)) {
+        switch (reg) {
+        case 0x803: /* MSP */
+            return env->msp;
+        case 0x804: /* ISP */
+            return env->aregs[7];
+        }
+    }
+    if (m68k_feature(env, M68K_FEATURE_M68040_MMU)) {
+        switch (reg) {
+        case 0x003: /* TC */
+            return env->mmu.tcr;
+        case 0x004: case 0x005: /* ITT0, ITT1 */
+        case 0x006: case 0x007: /* DTT0, DTT1 */
+            return env->mmu.ttr[reg - 0x004];
+        case 0x805: /* MMUSR */
+            return env->mmu.mmusr;
+        case 0x806: /* URP */
+            return env->mmu.urp;
+        case 0x807: /* SRP */
+            return env->mmu.srp;
+        }
+    }
+    if (m68k_feature(env, M68K_FEATURE_M68060)) {
+        switch (reg) {
+        case 0x008: /* BUSCR */
+            return env->buscr;
+        case 0x808: /* PCR */
+            return M68K_PCR_ID | env->pcr;
+        }
+    }
+    m68k_movec_illegal(env, GETPC());
+}
+
 void HELPER(set_macsr)(CPUM68KState *env, uint32_t val)
 {
     uint32_t acc;
@@ -232,7 +369,11 @@ void m68k_switch_sp(CPUM68KState *env)
     int new_sp;
 
     env->sp[env->current_sp] = env->aregs[7];
-    new_sp = (env->sr & SR_S && env->cacr & M68K_CACR_EUSP)
+    /* ColdFire cores only have a separate supervisor stack when it is
+       enabled in CACR, 680x0 cores always have one.  */
+    new_sp = (env->sr & SR_S &&
+              (m68k_feature(env, M68K_FEATURE_M68000) ||
+               env->cacr & M68K_CACR_EUSP))
              ? M68K_SSP : M68K_USP;
     env->aregs[7] = env->sp[new_sp];
     env->current_sp = new_sp;
@@ -252,23 +393,348 @@ int m68k_cpu_handle_mmu_fault(CPUState *cs, vaddr address, int rw,
 
 #else
 
-/* MMU */
+/* MMU: 68040/68060 */
+
+#define M68K_ACCESS_STORE 0x01
+#define M68K_ACCESS_CODE  0x02
+#define M68K_ACCESS_SUPER 0x04
+#define M68K_ACCESS_DEBUG 0x08 /* no side effects on the ATC or tables */
+#define M68K_ACCESS_PTEST 0x10 /* report the translation in MMUSR */
+
+static inline int m68k_page_bits(CPUM68KState *env)
+{
+    return env->mmu.tcr & M68K_TCR_PAGE_8K ? 13 : 12;
+}
+
+static inline M68kATCEntry *m68k_atc_entry(CPUM68KState *env,
+                                           uint32_t address, int fc)
+{
+    uint32_t index = (address >> m68k_page_bits(env)) ^
+                     (fc << (M68K_ATC_BITS - 3));
+
+    return &env->atc[index & (M68K_ATC_SIZE - 1)];
+}
+
+/* Match ADDRESS against the pair of transparent translation registers
+   starting at TTR and return the access rights they grant, or 0.  */
+static int m68k_check_ttr(CPUM68KState *env, uint32_t address,
+                          int access_type, int ttr, int prot)
+{
+    int i;
+
+    for (i = ttr; i < ttr + 2; i++) {
+        uint32_t val = env->mmu.ttr[i];
+        uint32_t mask;
+
+        if (!(val & M68K_TTR_ENABLED)) {
+            continue;
+        }
+        if ((val & M68K_TTR_SFIELD) == M68K_TTR_SFIELD_USER) {
+            if (access_type & M68K_ACCESS_SUPER) {
+                continue;
+            }
+        } else if ((val & M68K_TTR_SFIELD) == M68K_TTR_SFIELD_SUPER) {
+            if (!(access_type & M68K_ACCESS_SUPER)) {
+                continue;
+            }
+        }
+        mask = ~(val << 8) & M68K_TTR_ADDRESS_BASE;
+        if ((address & mask) != (val & mask)) {
+            continue;
+        }
+        if (val & M68K_TTR_WRITE_PROT) {
+            prot &= ~PAGE_WRITE;
+        }
+        return prot;
+    }
+    return 0;
+}
+
+/* Read a root or pointer table descriptor, marking it used.  */
+static uint32_t m68k_read_table_desc(CPUState *cs, uint32_t desc_addr,
+                                     int access_type)
+{
+    uint32_t desc = ldl_phys(cs->as, desc_addr);
+
+    if ((desc & M68K_DESC_RESIDENT) && !(desc & M68K_DESC_USED) &&
+        !(access_type & M68K_ACCESS_DEBUG)) {
+        desc |= M68K_DESC_USED;
+        stl_phys(cs->as, desc_addr, desc);
+    }
+    return desc;
+}
+
+/* Walk the three level translation tree below ROOT for ADDRESS.
+   On success fill in the descriptor fields of E and return 0.  */
+static int m68k_table_walk(CPUM68KState *env, M68kATCEntry *e,
+                           uint32_t address, uint32_t root, int access_type)
+{
+    CPUState *cs = CPU(m68k_env_get_cpu(env));
+    uint32_t desc, desc_addr, wp;
+
+    /* Root table, indexed by bits 31-25.  */
+    desc_addr = (root & ~0x1ff) | ((address >> 23) & 0x1fc);
+    desc = m68k_read_table_desc(cs, desc_addr, access_type);
+    if (!(desc & M68K_DESC_RESIDENT)) {
+        return -1;
+    }
+    wp = desc;
+
+    /* Pointer table, indexed by bits 24-18.  */
+    desc_addr = (desc & ~0x1ff) | ((address >> 16) & 0x1fc);
+    desc = m68k_read_table_desc(cs, desc_addr, access_type);
+    if (!(desc & M68K_DESC_RESIDENT)) {
+        return -1;
+    }
+    wp |= desc;
+
+    /* Page table, indexed by bits 17-12 or 17-13.  */
+    if (env->mmu.tcr & M68K_TCR_PAGE_8K) {
+        desc_addr = (desc & ~0x7f) | ((address >> 11) & 0x7c);
+    } else {
+        desc_addr = (desc & ~0xff) | ((address >> 10) & 0xfc);
+    }
+    desc = ldl_phys(cs->as, desc_addr);
+    if ((desc & M68K_PDT_MASK) == M68K_PDT_INDIRECT) {
+        desc_addr = desc & ~3;
+        desc = ldl_phys(cs->as, desc_addr);
+        if ((desc & M68K_PDT_MASK) == M68K_PDT_INDIRECT) {
+            return -1;
+        }
+    }
+    if ((desc & M68K_PDT_MASK) == M68K_PDT_INVALID) {
+        return -1;
+    }
+    if (!(desc & M68K_DESC_USED) && !(access_type & M68K_ACCESS_DEBUG)) {
+        desc |= M68K_DESC_USED;
+        stl_phys(cs->as, desc_addr, desc);
+    }
+
+    e->desc = desc | (wp & M68K_DESC_WRITEPROT);
+    e->desc_addr = desc_addr;
+    return 0;
+}
+
+static int get_physical_address(CPUM68KState *env, hwaddr *physical,
+                                int *prot, uint32_t address,
+                                int access_type, uint32_t *page_size)
+{
+    CPUState *cs = CPU(m68k_env_get_cpu(env));
+    bool super = access_type & M68K_ACCESS_SUPER;
+    bool code = access_type & M68K_ACCESS_CODE;
+    int fc = (super ? 4 : 0) | (code ? 2 : 1);
+    uint32_t page_mask = ~0u << m68k_page_bits(env);
+    uint32_t root = super ? env->mmu.srp : env->mmu.urp;
+    int iprot, dprot;
+    M68kATCEntry *e, walk;
+    uint32_t tag, desc;
+
+    /* Transparent translation takes priority over the page tables.
+       Grant the rights of both register pairs so that code and data
+       in the same page do not evict each other from the TLB.  */
+    iprot = m68k_check_ttr(env, address, access_type, M68K_ITTR0,
+                           PAGE_READ | PAGE_EXEC);
+    dprot = m68k_check_ttr(env, address, access_type, M68K_DTTR0,
+                           PAGE_READ | PAGE_WRITE);
+    if (code ? iprot : dprot) {
+        if (access_type & M68K_ACCESS_PTEST) {
+            env->mmu.mmusr = M68K_MMU_T_040 | M68K_MMU_R_040;
+        }
+        *prot = iprot | dprot;
+        if ((access_type & M68K_ACCESS_STORE) && !(*prot & PAGE_WRITE)) {
+            return -1;
+        }
+        *physical = address & TARGET_PAGE_MASK;
+        *page_size = TARGET_PAGE_SIZE;
+        return 0;
+    }
+
+    tag = (address & page_mask) | (fc << 1) | 1;
+    e = m68k_atc_entry(env, address, fc);
+    if (e->tag != tag || e->root != root) {
+        if (m68k_table_walk(env, &walk, address, root, access_type) < 0) {
+            return -1;
+        }
+        walk.tag = tag;
+        walk.root = root;
+        if (access_type & M68K_ACCESS_DEBUG) {
+            e = &walk;
+        } else {
+            *e = walk;
+        }
+    }
+    desc = e->desc;
+
+    if (access_type & M68K_ACCESS_PTEST) {
+        env->mmu.mmusr = (desc & page_mask) |
+                         (desc & (M68K_MMU_GLOBAL_040 | 0x300 |
+                                  M68K_MMU_SUPER_040 | 0x60 |
+                                  M68K_MMU_M_040 | M68K_MMU_WP_040)) |
+                         M68K_MMU_R_040;
+    }
+    if ((desc & M68K_DESC_SUPERVISOR) && !super) {
+        return -1;
+    }
+    if (access_type & M68K_ACCESS_STORE) {
+        if (desc & M68K_DESC_WRITEPROT) {
+            return -1;
+        }
+        if (!(desc & M68K_DESC_MODIFIED) &&
+            !(access_type & (M68K_ACCESS_DEBUG | M68K_ACCESS_PTEST))) {
+            desc |= M68K_DESC_MODIFIED;
+            e->desc = desc;
+            stl_phys(cs->as, e->desc_addr,
+                     ldl_phys(cs->as, e->desc_addr) | M68K_DESC_MODIFIED);
+        }
+    }
+
+    /* Writes to a page that is not yet modified must come back here
+       to set M in its descriptor.  */
+    *prot = PAGE_READ | PAGE_EXEC;
+    if ((desc & (M68K_DESC_WRITEPROT | M68K_DESC_MODIFIED)) ==
+        M68K_DESC_MODIFIED) {
+        *prot |= PAGE_WRITE;
+    }
+    *physical = desc & page_mask;
+    *page_size = ~page_mask + 1;
+    return 0;
+}
 
-/* TODO: This will need fixing once the MMU is implemented.  */
 hwaddr m68k_cpu_get_phys_page_debug(CPUState *cs, vaddr addr)
 {
-    return addr;
+    M68kCPU *cpu = M68K_CPU(cs);
+    CPUM68KState *env = &cpu->env;
+    hwaddr physical;
+    int prot;
+    int access_type;
+    uint32_t page_size;
+
+    if (!m68k_feature(env, M68K_FEATURE_M68040_MMU) ||
+        !(env->mmu.tcr & M68K_TCR_ENABLED)) {
+        return addr;
+    }
+
+    access_type = M68K_ACCESS_DEBUG;
+    if (env->sr & SR_S) {
+        access_type |= M68K_ACCESS_SUPER;
+    }
+    if (get_physical_address(env, &physical, &prot, addr,
+                             access_type, &page_size) != 0) {
+        return -1;
+    }
+    return physical + (addr & (page_size - 1) & TARGET_PAGE_MASK);
 }
 
 int m68k_cpu_handle_mmu_fault(CPUState *cs, vaddr address, int rw,
                               int mmu_idx)
 {
+    M68kCPU *cpu = M68K_CPU(cs);
+    CPUM68KState *env = &cpu->env;
+    hwaddr physical;
     int prot;
+    int access_type;
+    uint32_t page_size;
+
+    if (!m68k_feature(env, M68K_FEATURE_M68040_MMU) ||
+        !(env->mmu.tcr & M68K_TCR_ENABLED)) {
+        address &= TARGET_PAGE_MASK;
+        prot = PAGE_READ | PAGE_WRITE | PAGE_EXEC;
+        tlb_set_page(cs, address, address, prot, mmu_idx, TARGET_PAGE_SIZE);
+        return 0;
+    }
 
-    address &= TARGET_PAGE_MASK;
-    prot = PAGE_READ | PAGE_WRITE | PAGE_EXEC;
-    tlb_set_page(cs, address, address, prot, mmu_idx, TARGET_PAGE_SIZE);
-    return 0;
+    access_type = 0;
+    if (rw == MMU_INST_FETCH) {
+        access_type |= M68K_ACCESS_CODE;
+    } else if (rw == MMU_DATA_STORE) {
+        access_type |= M68K_ACCESS_STORE;
+    }
+    if (mmu_idx != MMU_USER_IDX) {
+        access_type |= M68K_ACCESS_SUPER;
+    }
+
+    if (get_physical_address(env, &physical, &prot, address,
+                             access_type, &page_size) == 0) {
+        /* Only map the TARGET_PAGE_SIZE piece that was touched, the rest
+           of the page is refilled from the ATC without a table walk.  */
+        physical += address & (page_size - 1) & TARGET_PAGE_MASK;
+        tlb_set_page(cs, address & TARGET_PAGE_MASK, physical, prot,
+                     mmu_idx, TARGET_PAGE_SIZE);
+        return 0;
+    }
+
+    env->mmu.ssw = M68K_SSW_ATC_040;
+    env->mmu.ssw |= access_type & M68K_ACCESS_SUPER ? M68K_SSW_TM_SUPER : 0;
+    env->mmu.ssw |= access_type & M68K_ACCESS_CODE ? M68K_SSW_TM_CODE
+                                                   : M68K_SSW_TM_DATA;
+    if (!(access_type & M68K_ACCESS_STORE)) {
+        env->mmu.ssw |= M68K_SSW_RW_040;
+    }
+    env->mmu.ar = address;
+    cs->exception_index = EXCP_ACCESS;
+    return 1;
+}
+
+void HELPER(ptest)(CPUM68KState *env, uint32_t addr, uint32_t is_read)
+{
+    hwaddr physical;
+    int prot;
+    int access_type;
+    uint32_t page_size;
+
+    access_type = M68K_ACCESS_PTEST;
+    if (env->dfc & 4) {
+        access_type |= M68K_ACCESS_SUPER;
+    }
+    if ((env->dfc & 3) == 2) {
+        access_type |= M68K_ACCESS_CODE;
+    }
+    if (!is_read) {
+        access_type |= M68K_ACCESS_STORE;
+    }
+    env->mmu.mmusr = 0;
+    get_physical_address(env, &physical, &prot, addr, access_type,
+                         &page_size);
+}
+
+void HELPER(pflush)(CPUM68KState *env, uint32_t addr, uint32_t opmode)
+{
+    CPUState *cs = CPU(m68k_env_get_cpu(env));
+    bool global = opmode & 1;
+    uint32_t page_mask = ~0u << m68k_page_bits(env);
+    int i;
+
+    if (opmode & 2) {
+        /* PFLUSHA, PFLUSHAN: entries of every root pointer go.  */
+        for (i = 0; i < M68K_ATC_SIZE; i++) {
+            if (global || !(env->atc[i].desc & M68K_DESC_GLOBAL)) {
+                env->atc[i].tag = 0;
+            }
+        }
+        tlb_flush(cs);
+    } else {
+        /* PFLUSH, PFLUSHN (An) flush the page from both the data and
+           the instruction ATC.  Only the S bit of DFC selects entries.  */
+        int super = env->dfc & 4;
+        int mmu_idx = super ? MMU_KERNEL_IDX : MMU_USER_IDX;
+        uint32_t page;
+        int fc;
+
+        for (fc = super | 1; fc <= (super | 2); fc++) {
+            M68kATCEntry *e = m68k_atc_entry(env, addr, fc);
+
+            if (((e->tag ^ addr) & page_mask) == 0 &&
+                (e->tag & 0xf) == ((fc << 1) | 1) &&
+                (global || !(e->desc & M68K_DESC_GLOBAL))) {
+                e->tag = 0;
+            }
+        }
+        addr &= page_mask;
+        for (page = addr; page - addr <= ~page_mask;
+             page += TARGET_PAGE_SIZE) {
+            tlb_flush_page_by_mmuidx(cs, page, 1 << mmu_idx);
+        }
+    }
 }
 
 /* Notify CPU of a pending interrupt.  Prioritization and vectoring should
@@ -339,43 +805,6 @@ void HELPER(mac_move)(CPUM68KState *env, uint32_t dest, uint32_t src)
         env->macsr &= ~mask;
 }
 
-uint64_t HELPER(macmuls)(CPUM68KState *env, uint32_t op1, uint32_t op2)
-{
-    int64_t product;
-    int64_t res;
-
-    product = (uint64_t)op1 * op2;
-    res = (product << 24) >> 24;
-    if (res != product) {
-        env->macsr |= MACSR_V;
-        if (env->macsr & MACSR_OMC) {
-            /* Make sure the accumulate operation overflows.  */
-            if (product < 0)
-                res = ~(1ll << 50);
-            else
-                res = 1ll << 50;
-        }
-    }
-    return res;
-}
-
-uint64_t HELPER(macmulu)(CPUM68KState *env, uint32_t op1, uint32_t op2)
-{
-    uint64_t product;
-
-    product = (uint64_t)op1 * op2;
-    if (product & (0xffffffull << 40)) {
-        env->macsr |= MACSR_V;
-        if (env->macsr & MACSR_OMC) {
-            /* Make sure the accumulate operation overflows.  */
-            product = 1ll << 50;
-        } else {
-            product &= ((1ull << 40) - 1);
-        }
-    }
-    return product;
-}
-
 uint64_t HELPER(macmulf)(CPUM68KState *env, uint32_t op1, uint32_t op2)
 {
     uint64_t product;
@@ -395,49 +824,6 @@ uint64_t HELPER(macmulf)(CPUM68KState *env, uint32_t op1, uint32_t op2)
     return product;
 }
 
-void HELPER(macsats)(CPUM68KState *env, uint32_t acc)
-{
-    int64_t tmp;
-    int64_t result;
-    tmp = env->macc[acc];
-    result = ((tmp << 16) >> 16);
-    if (result != tmp) {
-        env->macsr |= MACSR_V;
-    }
-    if (env->macsr & MACSR_V) {
-        env->macsr |= MACSR_PAV0 << acc;
-        if (env->macsr & MACSR_OMC) {
-            /* The result is saturated to 32 bits, despite overflow occurring
-               at 48 bits.  Seems weird, but that's what the hardware docs
-               say.  */
-            result = (result >> 63) ^ 0x7fffffff;
-        }
-    }
-    env->macc[acc] = result;
-}
-
-void HELPER(macsatu)(CPUM68KState *env, uint32_t acc)
-{
-    uint64_t val;
-
-    val = env->macc[acc];
-    if (val & (0xffffull << 48)) {
-        env->macsr |= MACSR_V;
-    }
-    if (env->macsr & MACSR_V) {
-        env->macsr |= MACSR_PAV0 << acc;
-        if (env->macsr & MACSR_OMC) {
-            if (val > (1ull << 53))
-                val = 0;
-            else
-                val = (1ull << 48) - 1;
-        } else {
-            val &= ((1ull << 48) - 1);
-        }
-    }
-    env->macc[acc] = val;
-}
-
 void HELPER(macsatf)(CPUM68KState *env, uint32_t acc)
 {
     int64_t sum;
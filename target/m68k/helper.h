@@ -1,14 +1,13 @@
-DEF_HELPER_1(bitrev, i32, i32)
-DEF_HELPER_1(ff1, i32, i32)
+DEF_HELPER_FLAGS_1(bitrev, TCG_CALL_NO_RWG_SE, i32, i32)
+DEF_HELPER_FLAGS_1(ff1, TCG_CALL_NO_RWG_SE, i32, i32)
 DEF_HELPER_FLAGS_2(sats, TCG_CALL_NO_RWG_SE, i32, i32, i32)
-DEF_HELPER_3(divuw, void, env, int, i32)
-DEF_HELPER_3(divsw, void, env, int, s32)
-DEF_HELPER_4(divul, void, env, int, int, i32)
-DEF_HELPER_4(divsl, void, env, int, int, s32)
-DEF_HELPER_4(divull, void, env, int, int, i32)
-DEF_HELPER_4(divsll, void, env, int, int, s32)
+DEF_HELPER_FLAGS_3(div0_check, TCG_CALL_NO_WG, void, env, i32, i32)
+DEF_HELPER_4(chk, void, env, s32, s32, i32)
+DEF_HELPER_FLAGS_3(trapcc, TCG_CALL_NO_WG, void, env, i32, i32)
 DEF_HELPER_2(set_sr, void, env, i32)
 DEF_HELPER_3(movec, void, env, i32, i32)
+DEF_HELPER_3(m68k_movec_to, void, env, i32, i32)
+DEF_HELPER_2(m68k_movec_from, i32, env, i32)
 DEF_HELPER_4(cas2w, void, env, i32, i32, i32)
 DEF_HELPER_4(cas2l, void, env, i32, i32, i32)
 DEF_HELPER_4(cas2l_parallel, void, env, i32, i32, i32)
@@ -17,87 +16,83 @@ DEF_HELPER_4(cas2l_parallel, void, env, i32, i32, i32)
 #define dh_ctype_fp FPReg *
 #define dh_is_signed_fp dh_is_signed_ptr
 
-DEF_HELPER_3(exts32, void, env, fp, s32)
-DEF_HELPER_3(extf32, void, env, fp, f32)
-DEF_HELPER_3(extf64, void, env, fp, f64)
-DEF_HELPER_2(redf32, f32, env, fp)
-DEF_HELPER_2(redf64, f64, env, fp)
-DEF_HELPER_2(reds32, s32, env, fp)
+DEF_HELPER_FLAGS_3(exts32, TCG_CALL_NO_RWG, void, env, fp, s32)
+DEF_HELPER_FLAGS_3(extf32, TCG_CALL_NO_RWG, void, env, fp, f32)
+DEF_HELPER_FLAGS_3(extf64, TCG_CALL_NO_RWG, void, env, fp, f64)
+DEF_HELPER_FLAGS_2(redf32, TCG_CALL_NO_RWG, f32, env, fp)
+DEF_HELPER_FLAGS_2(redf64, TCG_CALL_NO_RWG, f64, env, fp)
+DEF_HELPER_FLAGS_2(reds32, TCG_CALL_NO_RWG, s32, env, fp)
 
-DEF_HELPER_3(fsround, void, env, fp, fp)
-DEF_HELPER_3(fdround, void, env, fp, fp)
-DEF_HELPER_3(firound, void, env, fp, fp)
-DEF_HELPER_3(fitrunc, void, env, fp, fp)
-DEF_HELPER_3(fsqrt, void, env, fp, fp)
-DEF_HELPER_3(fssqrt, void, env, fp, fp)
-DEF_HELPER_3(fdsqrt, void, env, fp, fp)
-DEF_HELPER_3(fabs, void, env, fp, fp)
-DEF_HELPER_3(fsabs, void, env, fp, fp)
-DEF_HELPER_3(fdabs, void, env, fp, fp)
-DEF_HELPER_3(fneg, void, env, fp, fp)
-DEF_HELPER_3(fsneg, void, env, fp, fp)
-DEF_HELPER_3(fdneg, void, env, fp, fp)
-DEF_HELPER_4(fadd, void, env, fp, fp, fp)
-DEF_HELPER_4(fsadd, void, env, fp, fp, fp)
-DEF_HELPER_4(fdadd, void, env, fp, fp, fp)
-DEF_HELPER_4(fsub, void, env, fp, fp, fp)
-DEF_HELPER_4(fssub, void, env, fp, fp, fp)
-DEF_HELPER_4(fdsub, void, env, fp, fp, fp)
-DEF_HELPER_4(fmul, void, env, fp, fp, fp)
-DEF_HELPER_4(fsmul, void, env, fp, fp, fp)
-DEF_HELPER_4(fdmul, void, env, fp, fp, fp)
-DEF_HELPER_4(fsglmul, void, env, fp, fp, fp)
-DEF_HELPER_4(fdiv, void, env, fp, fp, fp)
-DEF_HELPER_4(fsdiv, void, env, fp, fp, fp)
-DEF_HELPER_4(fddiv, void, env, fp, fp, fp)
-DEF_HELPER_4(fsgldiv, void, env, fp, fp, fp)
-DEF_HELPER_FLAGS_3(fcmp, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(fsround, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(fdround, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(firound, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(fitrunc, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(fsqrt, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(fssqrt, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(fdsqrt, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(fabs, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(fsabs, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(fdabs, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(fneg, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(fsneg, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(fdneg, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_4(fadd, TCG_CALL_NO_RWG, void, env, fp, fp, fp)
+DEF_HELPER_FLAGS_4(fsadd, TCG_CALL_NO_RWG, void, env, fp, fp, fp)
+DEF_HELPER_FLAGS_4(fdadd, TCG_CALL_NO_RWG, void, env, fp, fp, fp)
+DEF_HELPER_FLAGS_4(fsub, TCG_CALL_NO_RWG, void, env, fp, fp, fp)
+DEF_HELPER_FLAGS_4(fssub, TCG_CALL_NO_RWG, void, env, fp, fp, fp)
+DEF_HELPER_FLAGS_4(fdsub, TCG_CALL_NO_RWG, void, env, fp, fp, fp)
+DEF_HELPER_FLAGS_4(fmul, TCG_CALL_NO_RWG, void, env, fp, fp, fp)
+DEF_HELPER_FLAGS_4(fsmul, TCG_CALL_NO_RWG, void, env, fp, fp, fp)
+DEF_HELPER_FLAGS_4(fdmul, TCG_CALL_NO_RWG, void, env, fp, fp, fp)
+DEF_HELPER_FLAGS_4(fsglmul, TCG_CALL_NO_RWG, void, env, fp, fp, fp)
+DEF_HELPER_FLAGS_4(fdiv, TCG_CALL_NO_RWG, void, env, fp, fp, fp)
+DEF_HELPER_FLAGS_4(fsdiv, TCG_CALL_NO_RWG, void, env, fp, fp, fp)
+DEF_HELPER_FLAGS_4(fddiv, TCG_CALL_NO_RWG, void, env, fp, fp, fp)
+DEF_HELPER_FLAGS_4(fsgldiv, TCG_CALL_NO_RWG, void, env, fp, fp, fp)
+DEF_HELPER_FLAGS_3(fcmp, TCG_CALL_NO_WG, i32, env, fp, fp)
 DEF_HELPER_FLAGS_2(set_fpcr, TCG_CALL_NO_RWG, void, env, i32)
-DEF_HELPER_FLAGS_2(ftst, TCG_CALL_NO_RWG, void, env, fp)
-DEF_HELPER_3(fconst, void, env, fp, i32)
-DEF_HELPER_3(fmovemx_st_predec, i32, env, i32, i32)
-DEF_HELPER_3(fmovemx_st_postinc, i32, env, i32, i32)
-DEF_HELPER_3(fmovemx_ld_postinc, i32, env, i32, i32)
-DEF_HELPER_3(fmovemd_st_predec, i32, env, i32, i32)
-DEF_HELPER_3(fmovemd_st_postinc, i32, env, i32, i32)
-DEF_HELPER_3(fmovemd_ld_postinc, i32, env, i32, i32)
-DEF_HELPER_4(fmod, void, env, fp, fp, fp)
-DEF_HELPER_4(frem, void, env, fp, fp, fp)
-DEF_HELPER_3(fgetexp, void, env, fp, fp)
-DEF_HELPER_3(fgetman, void, env, fp, fp)
-DEF_HELPER_4(fscale, void, env, fp, fp, fp)
-DEF_HELPER_3(flognp1, void, env, fp, fp)
-DEF_HELPER_3(flogn, void, env, fp, fp)
-DEF_HELPER_3(flog10, void, env, fp, fp)
-DEF_HELPER_3(flog2, void, env, fp, fp)
-DEF_HELPER_3(fetox, void, env, fp, fp)
-DEF_HELPER_3(ftwotox, void, env, fp, fp)
-DEF_HELPER_3(ftentox, void, env, fp, fp)
-DEF_HELPER_3(ftan, void, env, fp, fp)
-DEF_HELPER_3(fsin, void, env, fp, fp)
-DEF_HELPER_3(fcos, void, env, fp, fp)
-DEF_HELPER_4(fsincos, void, env, fp, fp, fp)
-DEF_HELPER_3(fatan, void, env, fp, fp)
-DEF_HELPER_3(fasin, void, env, fp, fp)
-DEF_HELPER_3(facos, void, env, fp, fp)
-DEF_HELPER_3(fatanh, void, env, fp, fp)
-DEF_HELPER_3(ftanh, void, env, fp, fp)
-DEF_HELPER_3(fsinh, void, env, fp, fp)
-DEF_HELPER_3(fcosh, void, env, fp, fp)
+DEF_HELPER_FLAGS_2(ftst, TCG_CALL_NO_RWG, i32, env, fp)
+DEF_HELPER_FLAGS_3(fconst, TCG_CALL_NO_RWG, void, env, fp, i32)
+DEF_HELPER_FLAGS_3(fmovemx_st_predec, TCG_CALL_NO_WG, i32, env, i32, i32)
+DEF_HELPER_FLAGS_3(fmovemx_st_postinc, TCG_CALL_NO_WG, i32, env, i32, i32)
+DEF_HELPER_FLAGS_3(fmovemx_ld_postinc, TCG_CALL_NO_WG, i32, env, i32, i32)
+DEF_HELPER_FLAGS_3(fmovemd_st_predec, TCG_CALL_NO_WG, i32, env, i32, i32)
+DEF_HELPER_FLAGS_3(fmovemd_st_postinc, TCG_CALL_NO_WG, i32, env, i32, i32)
+DEF_HELPER_FLAGS_3(fmovemd_ld_postinc, TCG_CALL_NO_WG, i32, env, i32, i32)
+DEF_HELPER_FLAGS_4(fmod, TCG_CALL_NO_RWG, void, env, fp, fp, fp)
+DEF_HELPER_FLAGS_4(frem, TCG_CALL_NO_RWG, void, env, fp, fp, fp)
+DEF_HELPER_FLAGS_3(fgetexp, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(fgetman, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_4(fscale, TCG_CALL_NO_RWG, void, env, fp, fp, fp)
+DEF_HELPER_FLAGS_3(flognp1, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(flogn, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(flog10, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(flog2, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(fetox, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(ftwotox, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(ftentox, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(ftan, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(fsin, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(fcos, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_4(fsincos, TCG_CALL_NO_RWG, void, env, fp, fp, fp)
+DEF_HELPER_FLAGS_3(fatan, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(fasin, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(facos, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(fatanh, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(ftanh, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(fsinh, TCG_CALL_NO_RWG, void, env, fp, fp)
+DEF_HELPER_FLAGS_3(fcosh, TCG_CALL_NO_RWG, void, env, fp, fp)
 DEF_HELPER_FLAGS_2(update_fpstatus, TCG_CALL_NO_RWG, void, env, i32)
 
 DEF_HELPER_3(mac_move, void, env, i32, i32)
 DEF_HELPER_3(macmulf, i64, env, i32, i32)
-DEF_HELPER_3(macmuls, i64, env, i32, i32)
-DEF_HELPER_3(macmulu, i64, env, i32, i32)
-DEF_HELPER_2(macsats, void, env, i32)
-DEF_HELPER_2(macsatu, void, env, i32)
 DEF_HELPER_2(macsatf, void, env, i32)
 DEF_HELPER_2(mac_set_flags, void, env, i32)
 DEF_HELPER_2(set_macsr, void, env, i32)
 DEF_HELPER_2(get_macf, i32, env, i64)
-DEF_HELPER_1(get_macs, i32, i64)
-DEF_HELPER_1(get_macu, i32, i64)
+DEF_HELPER_FLAGS_1(get_macs, TCG_CALL_NO_RWG_SE, i32, i64)
+DEF_HELPER_FLAGS_1(get_macu, TCG_CALL_NO_RWG_SE, i32, i64)
 DEF_HELPER_2(get_mac_extf, i32, env, i32)
 DEF_HELPER_2(get_mac_exti, i32, env, i32)
 DEF_HELPER_3(set_mac_extf, void, env, i32, i32)
@@ -118,3 +113,8 @@ DEF_HELPER_FLAGS_4(bfchg_mem, TCG_CALL_NO_WG, i32, env, i32, s32, i32)
 DEF_HELPER_FLAGS_4(bfclr_mem, TCG_CALL_NO_WG, i32, env, i32, s32, i32)
 DEF_HELPER_FLAGS_4(bfset_mem, TCG_CALL_NO_WG, i32, env, i32, s32, i32)
 DEF_HELPER_FLAGS_4(bfffo_mem, TCG_CALL_NO_WG, i64, env, i32, s32, i32)
+
+#if defined(CONFIG_SOFTMMU)
+DEF_HELPER_3(ptest, void, env, i32, i32)
+DEF_HELPER_3(pflush, void, env, i32, i32)
+#endif
@@ -54,7 +54,7 @@ void tlb_fill(CPUState *cs, target_ulong addr, MMUAccessType access_type,
     }
 }
 
-static void do_rte(CPUM68KState *env)
+static void cf_rte(CPUM68KState *env)
 {
     uint32_t sp;
     uint32_t fmt;
@@ -68,7 +68,41 @@ static void do_rte(CPUM68KState *env)
     helper_set_sr(env, fmt);
 }
 
-static void do_interrupt_all(CPUM68KState *env, int is_hw)
+static void m68k_rte(CPUM68KState *env)
+{
+    uint32_t sp;
+    uint16_t fmt;
+    uint16_t sr;
+
+    sp = env->aregs[7];
+    sr = cpu_lduw_kernel(env, sp);
+    env->pc = cpu_ldl_kernel(env, sp + 2);
+    sp += 6;
+    /* The 68000 is the only model without a format/vector word, and the
+       only one without the full extension word addressing modes.  */
+    if (m68k_feature(env, M68K_FEATURE_EXT_FULL)) {
+        fmt = cpu_lduw_kernel(env, sp);
+        sp += 2;
+        switch (fmt >> 12) {
+        case 0:
+            break;
+        case 2:
+        case 3:
+            sp += 4;
+            break;
+        case 4:
+            sp += 8;
+            break;
+        case 7:
+            sp += 52;
+            break;
+        }
+    }
+    env->aregs[7] = sp;
+    helper_set_sr(env, sr);
+}
+
+static void cf_interrupt_all(CPUM68KState *env, int is_hw)
 {
     CPUState *cs = CPU(m68k_env_get_cpu(env));
     uint32_t sp;
@@ -83,7 +117,7 @@ static void do_interrupt_all(CPUM68KState *env, int is_hw)
         switch (cs->exception_index) {
         case EXCP_RTE:
             /* Return from an exception.  */
-            do_rte(env);
+            cf_rte(env);
             return;
         case EXCP_HALT_INSN:
             if (semihosting_enabled()
@@ -114,7 +148,7 @@ static void do_interrupt_all(CPUM68KState *env, int is_hw)
     fmt |= env->sr;
     fmt |= cpu_m68k_get_ccr(env);
 
-    env->sr |= SR_S;
+    env->sr = (env->sr | SR_S) & ~SR_T;
     if (is_hw) {
         env->sr = (env->sr & ~SR_I) | (env->pending_level << SR_I_SHIFT);
         env->sr &= ~SR_M;
@@ -134,6 +168,103 @@ static void do_interrupt_all(CPUM68KState *env, int is_hw)
     env->pc = cpu_ldl_kernel(env, env->vbr + vector);
 }
 
+static void do_stack_frame(CPUM68KState *env, uint32_t *sp,
+                           uint16_t format, uint16_t sr, uint32_t retaddr,
+                           uint32_t vector)
+{
+    if (m68k_feature(env, M68K_FEATURE_EXT_FULL)) {
+        *sp -= 2;
+        cpu_stw_kernel(env, *sp, (format << 12) | vector);
+    }
+    *sp -= 4;
+    cpu_stl_kernel(env, *sp, retaddr);
+    *sp -= 2;
+    cpu_stw_kernel(env, *sp, sr);
+}
+
+static void m68k_interrupt_all(CPUM68KState *env, int is_hw)
+{
+    CPUState *cs = CPU(m68k_env_get_cpu(env));
+    uint32_t sp;
+    uint32_t retaddr;
+    uint32_t vector;
+    uint16_t sr;
+    int i;
+
+    retaddr = env->pc;
+
+    if (!is_hw) {
+        if (cs->exception_index == EXCP_RTE) {
+            /* Return from an exception.  */
+            m68k_rte(env);
+            return;
+        }
+        if (cs->exception_index >= EXCP_TRAP0
+            && cs->exception_index <= EXCP_TRAP15) {
+            /* Move the PC after the trap instruction.  */
+            retaddr += 2;
+        }
+    }
+
+    vector = cs->exception_index << 2;
+    sr = env->sr | cpu_m68k_get_ccr(env);
+
+    env->sr = (env->sr | SR_S) & ~SR_T;
+    if (is_hw) {
+        env->sr = (env->sr & ~SR_I) | (env->pending_level << SR_I_SHIFT);
+        env->sr &= ~SR_M;
+    }
+    m68k_switch_sp(env);
+    sp = env->aregs[7];
+
+    /* ??? This could cause MMU faults.  */
+    if (cs->exception_index == EXCP_ACCESS &&
+        m68k_feature(env, M68K_FEATURE_M68040_MMU)) {
+        /* Format 7 access error frame.  The faulting instruction is
+           restarted, so there are never pending write-backs: the push
+           data, write-back data/address and status words are zero.  */
+        for (i = 0; i < 9; i++) {
+            sp -= 4;
+            cpu_stl_kernel(env, sp, 0);
+        }
+        sp -= 4;
+        cpu_stl_kernel(env, sp, env->mmu.ar); /* fault address */
+        for (i = 0; i < 3; i++) {
+            sp -= 2;
+            cpu_stw_kernel(env, sp, 0);
+        }
+        sp -= 2;
+        cpu_stw_kernel(env, sp, env->mmu.ssw);
+        sp -= 4;
+        cpu_stl_kernel(env, sp, env->mmu.ar); /* effective address */
+        do_stack_frame(env, &sp, 7, sr, retaddr, vector);
+    } else if ((cs->exception_index == EXCP_DIV0 ||
+                cs->exception_index == EXCP_CHK ||
+                cs->exception_index == EXCP_TRAPCC ||
+                cs->exception_index == EXCP_TRACE) &&
+               m68k_feature(env, M68K_FEATURE_EXT_FULL)) {
+        /* Format 2 frame: the address of the instruction that caused
+           the exception follows the PC of the next one.  */
+        sp -= 4;
+        cpu_stl_kernel(env, sp, env->mmu.ar);
+        do_stack_frame(env, &sp, 2, sr, retaddr, vector);
+    } else {
+        do_stack_frame(env, &sp, 0, sr, retaddr, vector);
+    }
+    env->aregs[7] = sp;
+    /* Jump to vector.  */
+    env->pc = cpu_ldl_kernel(env, env->vbr + vector);
+}
+
+static void do_interrupt_all(CPUM68KState *env, int is_hw)
+{
+    if (m68k_feature(env, M68K_FEATURE_M68000)) {
+        m68k_interrupt_all(env, is_hw);
+    } else {
+        cf_interrupt_all(env, is_hw);
+    }
+}
+
 void m68k_cpu_do_interrupt(CPUState *cs)
 {
     M68kCPU *cpu = M68K_CPU(cs);
@@ -184,184 +315,109 @@ void HELPER(raise_exception)(CPUM68KState *env, uint32_t tt)
     raise_exception(env, tt);
 }
 
-void HELPER(divuw)(CPUM68KState *env, int destr, uint32_t den)
+/* Raise exception TT for the instruction of ILEN bytes that called the
+   helper returning to RADDR.  The 680x0 reports these exceptions with a
+   format 2 frame: the stacked PC is that of the next instruction, and
+   the address of the instruction itself is kept in mmu.ar for the extra
+   frame word.  ColdFire restarts from the instruction.  */
+static void QEMU_NORETURN raise_exception_format2(CPUM68KState *env, int tt,
+                                                  int ilen, uintptr_t raddr)
 {
-    uint32_t num = env->dregs[destr];
-    uint32_t quot, rem;
+    CPUState *cs = CPU(m68k_env_get_cpu(env));
 
-    if (den == 0) {
-        raise_exception_ra(env, EXCP_DIV0, GETPC());
+    cs->exception_index = tt;
+    /* Recover PC and cc_op for the beginning of the insn.  */
+    cpu_restore_state(cs, raddr);
+    if (tt != EXCP_DIV0) {
+        /* CHK and TRAPcc flush the flags before they are checked.  */
+        env->cc_op = CC_OP_FLAGS;
     }
-    quot = num / den;
-    rem = num % den;
-
-    env->cc_c = 0; /* always cleared, even if overflow */
-    if (quot > 0xffff) {
-        env->cc_v = -1;
-        /* real 68040 keeps N and unset Z on overflow,
-         * whereas documentation says "undefined"
-         */
-        env->cc_z = 1;
-        return;
+    env->mmu.ar = env->pc;
+    if (m68k_feature(env, M68K_FEATURE_M68000)) {
+        env->pc += ilen;
     }
-    env->dregs[destr] = deposit32(quot, 16, 16, rem);
-    env->cc_z = (int16_t)quot;
-    env->cc_n = (int16_t)quot;
-    env->cc_v = 0;
+    cpu_loop_exit(cs);
 }
 
-void HELPER(divsw)(CPUM68KState *env, int destr, int32_t den)
+void HELPER(div0_check)(CPUM68KState *env, uint32_t den, uint32_t ilen)
 {
-    int32_t num = env->dregs[destr];
-    uint32_t quot, rem;
-
     if (den == 0) {
-        raise_exception_ra(env, EXCP_DIV0, GETPC());
-    }
-    quot = num / den;
-    rem = num % den;
-
-    env->cc_c = 0; /* always cleared, even if overflow */
-    if (quot != (int16_t)quot) {
-        env->cc_v = -1;
-        /* nothing else is modified */
-        /* real 68040 keeps N and unset Z on overflow,
-         * whereas documentation says "undefined"
-         */
-        env->cc_z = 1;
-        return;
+        raise_exception_format2(env, EXCP_DIV0, ilen, GETPC());
     }
-    env->dregs[destr] = deposit32(quot, 16, 16, rem);
-    env->cc_z = (int16_t)quot;
-    env->cc_n = (int16_t)quot;
-    env->cc_v = 0;
 }
 
-void HELPER(divul)(CPUM68KState *env, int numr, int regr, uint32_t den)
+void HELPER(chk)(CPUM68KState *env, int32_t val, int32_t ub, uint32_t ilen)
 {
-    uint32_t num = env->dregs[numr];
-    uint32_t quot, rem;
+    /* X is not affected and Z, V and C are undefined.  N is set if VAL
+       is negative and cleared if it is above UB.  As on a real 68040,
+       leave Z and V alone and set C if the check fails.  */
+    env->cc_n = val;
+    env->cc_c = 0 <= ub ? val < 0 || val > ub : val > ub && val < 0;
 
-    if (den == 0) {
-        raise_exception_ra(env, EXCP_DIV0, GETPC());
-    }
-    quot = num / den;
-    rem = num % den;
-
-    env->cc_c = 0;
-    env->cc_z = quot;
-    env->cc_n = quot;
-    env->cc_v = 0;
-
-    if (m68k_feature(env, M68K_FEATURE_CF_ISA_A)) {
-        if (numr == regr) {
-            env->dregs[numr] = quot;
-        } else {
-            env->dregs[regr] = rem;
-        }
-    } else {
-        env->dregs[regr] = rem;
-        env->dregs[numr] = quot;
+    if (val < 0 || val > ub) {
+        raise_exception_format2(env, EXCP_CHK, ilen, GETPC());
     }
 }
 
-void HELPER(divsl)(CPUM68KState *env, int numr, int regr, int32_t den)
+void HELPER(trapcc)(CPUM68KState *env, uint32_t cond, uint32_t ilen)
 {
-    int32_t num = env->dregs[numr];
-    int32_t quot, rem;
-
-    if (den == 0) {
-        raise_exception_ra(env, EXCP_DIV0, GETPC());
-    }
-    quot = num / den;
-    rem = num % den;
-
-    env->cc_c = 0;
-    env->cc_z = quot;
-    env->cc_n = quot;
-    env->cc_v = 0;
-
-    if (m68k_feature(env, M68K_FEATURE_CF_ISA_A)) {
-        if (numr == regr) {
-            env->dregs[numr] = quot;
-        } else {
-            env->dregs[regr] = rem;
-        }
-    } else {
-        env->dregs[regr] = rem;
-        env->dregs[numr] = quot;
+    if (cond) {
+        raise_exception_format2(env, EXCP_TRAPCC, ilen, GETPC());
     }
 }
 
-void HELPER(divull)(CPUM68KState *env, int numr, int regr, uint32_t den)
+/* Return a host pointer through which the LEN bytes at ADDR can be
+ * accessed directly, or NULL if the range crosses a page boundary or is
+ * not backed by RAM in the TLB.  In that case the caller must fall back
+ * to the cpu_ld/st accessors.  The access must be followed by a call to
+ * m68k_bulk_access_end, so that in user mode a host fault is reported
+ * at return address RA.
+ */
+void *m68k_bulk_access_begin(CPUM68KState *env, uint32_t addr, int len,
+                             MMUAccessType access_type, uintptr_t ra)
 {
-    uint64_t num = deposit64(env->dregs[numr], 32, 32, env->dregs[regr]);
-    uint64_t quot;
-    uint32_t rem;
-
-    if (den == 0) {
-        raise_exception_ra(env, EXCP_DIV0, GETPC());
+    if ((addr & TARGET_PAGE_MASK) != ((addr + len - 1) & TARGET_PAGE_MASK)) {
+        return NULL;
     }
-    quot = num / den;
-    rem = num % den;
-
-    env->cc_c = 0; /* always cleared, even if overflow */
-    if (quot > 0xffffffffULL) {
-        env->cc_v = -1;
-        /* real 68040 keeps N and unset Z on overflow,
-         * whereas documentation says "undefined"
-         */
-        env->cc_z = 1;
-        return;
-    }
-    env->cc_z = quot;
-    env->cc_n = quot;
-    env->cc_v = 0;
-
-    /*
-     * If Dq and Dr are the same, the quotient is returned.
-     * therefore we set Dq last.
-     */
+#if defined(CONFIG_USER_ONLY)
+    helper_retaddr = ra;
+#endif
+    return tlb_vaddr_to_host(env, addr, access_type,
+                             cpu_mmu_index(env, false));
+}
 
-    env->dregs[regr] = rem;
-    env->dregs[numr] = quot;
+void m68k_bulk_access_end(void)
+{
+#if defined(CONFIG_USER_ONLY)
+    helper_retaddr = 0;
+#endif
 }
 
-void HELPER(divsll)(CPUM68KState *env, int numr, int regr, int32_t den)
+/* Raise any write fault on a CAS2 operand before either operand is
+ * modified, so that a fault on the second one cannot leave the first
+ * one updated.
+ */
+static void cas2_probe(CPUM68KState *env, uint32_t addr, int size,
+                       uintptr_t ra)
 {
-    int64_t num = deposit64(env->dregs[numr], 32, 32, env->dregs[regr]);
-    int64_t quot;
-    int32_t rem;
+#if defined(CONFIG_USER_ONLY)
+    if (page_check_range(addr, size, PAGE_WRITE) < 0) {
+        CPUState *cs = CPU(m68k_env_get_cpu(env));
 
-    if (den == 0) {
-        raise_exception_ra(env, EXCP_DIV0, GETPC());
+        cs->exception_index = EXCP_ACCESS;
+        env->mmu.ar = addr;
+        cpu_loop_exit_restore(cs, ra);
     }
-    quot = num / den;
-    rem = num % den;
-
-    env->cc_c = 0; /* always cleared, even if overflow */
-    if (quot != (int32_t)quot) {
-        env->cc_v = -1;
-        /* real 68040 keeps N and unset Z on overflow,
-         * whereas documentation says "undefined"
-         */
-        env->cc_z = 1;
-        return;
-    }
-    env->cc_z = quot;
-    env->cc_n = quot;
-    env->cc_v = 0;
-
-    /*
-     * If Dq and Dr are the same, the quotient is returned.
-     * therefore we set Dq last.
-     */
+#else
+    int mmu_idx = cpu_mmu_index(env, false);
 
-    env->dregs[regr] = rem;
-    env->dregs[numr] = quot;
+    probe_write(env, addr, mmu_idx, ra);
+    if ((addr ^ (addr + size - 1)) & TARGET_PAGE_MASK) {
+        probe_write(env, addr + size - 1, mmu_idx, ra);
+    }
+#endif
 }
 
-/* We're executing in a serial context -- no need to be atomic.  */
 void HELPER(cas2w)(CPUM68KState *env, uint32_t regs, uint32_t a1, uint32_t a2)
 {
     uint32_t Dc1 = extract32(regs, 9, 3);
@@ -375,6 +431,11 @@ void HELPER(cas2w)(CPUM68KState *env, uint32_t regs, uint32_t a1, uint32_t a2)
     int16_t l1, l2;
     uintptr_t ra = GETPC();
 
+    /* In a parallel context, the translator leaves through
+     * cpu_loop_exit_atomic and we get here under exclusive execution.
+     */
+    cas2_probe(env, a1, 2, ra);
+    cas2_probe(env, a2, 2, ra);
     l1 = cpu_lduw_data_ra(env, a1, ra);
     l2 = cpu_lduw_data_ra(env, a2, ra);
     if (l1 == c1 && l2 == c2) {
@@ -395,7 +456,7 @@ void HELPER(cas2w)(CPUM68KState *env, uint32_t regs, uint32_t a1, uint32_t a2)
 }
 
 static void do_cas2l(CPUM68KState *env, uint32_t regs, uint32_t a1, uint32_t a2,
-                     bool parallel)
+                     bool parallel, uintptr_t ra)
 {
     uint32_t Dc1 = extract32(regs, 9, 3);
     uint32_t Dc2 = extract32(regs, 6, 3);
@@ -406,7 +467,6 @@ static void do_cas2l(CPUM68KState *env, uint32_t regs, uint32_t a1, uint32_t a2,
     uint32_t u1 = env->dregs[Du1];
     uint32_t u2 = env->dregs[Du2];
     uint32_t l1, l2;
-    uintptr_t ra = GETPC();
 #if defined(CONFIG_ATOMIC64) && !defined(CONFIG_USER_ONLY)
     int mmu_idx = cpu_mmu_index(env, 0);
     TCGMemOpIdx oi;
@@ -446,6 +506,8 @@ static void do_cas2l(CPUM68KState *env, uint32_t regs, uint32_t a1, uint32_t a2,
         }
     } else {
         /* We're executing in a serial context -- no need to be atomic.  */
+        cas2_probe(env, a1, 4, ra);
+        cas2_probe(env, a2, 4, ra);
         l1 = cpu_ldl_data_ra(env, a1, ra);
         l2 = cpu_ldl_data_ra(env, a2, ra);
         if (l1 == c1 && l2 == c2) {
@@ -468,13 +530,13 @@ static void do_cas2l(CPUM68KState *env, uint32_t regs, uint32_t a1, uint32_t a2,
 
 void HELPER(cas2l)(CPUM68KState *env, uint32_t regs, uint32_t a1, uint32_t a2)
 {
-    do_cas2l(env, regs, a1, a2, false);
+    do_cas2l(env, regs, a1, a2, false, GETPC());
 }
 
 void HELPER(cas2l_parallel)(CPUM68KState *env, uint32_t regs, uint32_t a1,
                             uint32_t a2)
 {
-    do_cas2l(env, regs, a1, a2, true);
+    do_cas2l(env, regs, a1, a2, true, GETPC());
 }
 
 struct bf_data {
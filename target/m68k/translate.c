@@ -33,6 +33,10 @@
 #include "trace-tcg.h"
 #include "exec/log.h"
 
+#if defined(CONFIG_USER_ONLY)
+#include "syscall_nr.h"
+#endif
+
 //#define DEBUG_DISPATCH 1
 
 #define DEFO32(name, offset) static TCGv QREG_##name;
@@ -109,17 +113,19 @@ void m68k_tcg_init(void)
 
 /* internal defines */
 typedef struct DisasContext {
+    DisasContextBase base;
     CPUM68KState *env;
     target_ulong insn_pc; /* Start of the current instruction.  */
     target_ulong pc;
-    int is_jmp;
     CCOp cc_op; /* Current CC operation */
     int cc_op_synced;
     int user;
-    struct TranslationBlock *tb;
-    int singlestep_enabled;
+    int trace; /* Raise a trace exception after each instruction.  */
+    int max_insn_len; /* Longest possible instruction, in bytes.  */
     TCGv_i64 mactmp;
     int done_mac;
+    TCGv fpcc; /* float_relation matching the FPSR condition codes */
+    int fpcc_valid;
     int writeback_mask;
     TCGv writeback[8];
 } DisasContext;
@@ -170,7 +176,8 @@ static void do_writebacks(DisasContext *s)
 }
 
 /* is_jmp field values */
-#define DISAS_JUMP      DISAS_TARGET_0 /* only pc was modified dynamically */
+#define DISAS_JUMP      DISAS_TARGET_0 /* only pc was modified dynamically;
+                                          look up the next TB directly */
 #define DISAS_UPDATE    DISAS_TARGET_1 /* cpu state was modified dynamically */
 #define DISAS_TB_JUMP   DISAS_TARGET_2 /* only pc was modified statically */
 #define DISAS_JUMP_NEXT DISAS_TARGET_3
@@ -253,7 +260,7 @@ static void gen_jmp_im(DisasContext *s, uint32_t dest)
 {
     update_cc_op(s);
     tcg_gen_movi_i32(QREG_PC, dest);
-    s->is_jmp = DISAS_JUMP;
+    s->base.is_jmp = DISAS_JUMP;
 }
 
 /* Generate a jump to the address in qreg DEST.  */
@@ -261,7 +268,7 @@ static void gen_jmp(DisasContext *s, TCGv dest)
 {
     update_cc_op(s);
     tcg_gen_mov_i32(QREG_PC, dest);
-    s->is_jmp = DISAS_JUMP;
+    s->base.is_jmp = DISAS_JUMP;
 }
 
 static void gen_raise_exception(int nr)
@@ -277,6 +284,20 @@ static void gen_exception(DisasContext *s, uint32_t where, int nr)
     update_cc_op(s);
     gen_jmp_im(s, where);
     gen_raise_exception(nr);
+    s->base.is_jmp = DISAS_NORETURN;
+}
+
+/* Raise a trace exception for the current instruction.  The PC of the
+   next instruction must already be in QREG_PC.  */
+static void gen_raise_trace(DisasContext *s)
+{
+    TCGv tmp = tcg_const_i32(s->insn_pc);
+
+    update_cc_op(s);
+    tcg_gen_st_i32(tmp, cpu_env, offsetof(CPUM68KState, mmu.ar));
+    tcg_temp_free(tmp);
+    gen_raise_exception(EXCP_TRACE);
+    s->base.is_jmp = DISAS_NORETURN;
 }
 
 static inline void gen_addr_fault(DisasContext *s)
@@ -1428,7 +1449,7 @@ static void gen_lookup_tb(DisasContext *s)
 {
     update_cc_op(s);
     tcg_gen_movi_i32(QREG_PC, s->pc);
-    s->is_jmp = DISAS_UPDATE;
+    s->base.is_jmp = DISAS_UPDATE;
 }
 
 #define SRC_EA(env, result, opsize, op_sign, addrp) do {                \
@@ -1451,7 +1472,7 @@ static void gen_lookup_tb(DisasContext *s)
 static inline bool use_goto_tb(DisasContext *s, uint32_t dest)
 {
 #ifndef CONFIG_USER_ONLY
-    return (s->tb->pc & TARGET_PAGE_MASK) == (dest & TARGET_PAGE_MASK) ||
+    return (s->base.pc_first & TARGET_PAGE_MASK) == (dest & TARGET_PAGE_MASK) ||
            (s->insn_pc & TARGET_PAGE_MASK) == (dest & TARGET_PAGE_MASK);
 #else
     return true;
@@ -1461,17 +1482,45 @@ static inline bool use_goto_tb(DisasContext *s, uint32_t dest)
 /* Generate a jump to an immediate address.  */
 static void gen_jmp_tb(DisasContext *s, int n, uint32_t dest)
 {
-    if (unlikely(s->singlestep_enabled)) {
+    if (unlikely(s->base.singlestep_enabled)) {
         gen_exception(s, dest, EXCP_DEBUG);
+    } else if (unlikely(s->trace)) {
+        gen_jmp_im(s, dest);
+        gen_raise_trace(s);
     } else if (use_goto_tb(s, dest)) {
         tcg_gen_goto_tb(n);
         tcg_gen_movi_i32(QREG_PC, dest);
-        tcg_gen_exit_tb((uintptr_t)s->tb + n);
+        tcg_gen_exit_tb((uintptr_t)s->base.tb + n);
     } else {
         gen_jmp_im(s, dest);
-        tcg_gen_exit_tb(0);
+        tcg_gen_lookup_and_goto_ptr();
+    }
+    s->base.is_jmp = DISAS_TB_JUMP;
+}
+
+/* In a superblock (CF_HOT), whether translation can go on at DEST
+   rather than end the TB.  Only forward branches within the first page
+   are followed, so that [pc_first, pc_next) still covers all the guest
+   code of the TB for invalidation.  Loops end the TB at their back edge
+   and chain to themselves as usual.  */
+static bool superblock_follow(DisasContext *s, uint32_t dest)
+{
+    if (!(tb_cflags(s->base.tb) & CF_HOT) || s->base.singlestep_enabled ||
+        s->trace) {
+        return false;
     }
-    s->is_jmp = DISAS_TB_JUMP;
+    return dest >= s->pc &&
+           dest - (s->base.pc_first & TARGET_PAGE_MASK) <=
+           TARGET_PAGE_SIZE - s->max_insn_len;
+}
+
+/* Leave a superblock from the middle of the TB.  Both jump slots may be
+   needed at the end of the TB, so look the destination up instead.  */
+static void gen_side_exit(DisasContext *s, uint32_t dest)
+{
+    update_cc_op(s);
+    tcg_gen_movi_i32(QREG_PC, dest);
+    tcg_gen_lookup_and_goto_ptr();
 }
 
 DISAS_INSN(scc)
@@ -1492,6 +1541,57 @@ DISAS_INSN(scc)
     tcg_temp_free(tmp);
 }
 
+/* Raise a TRAPcc exception if condition C holds.  */
+static void gen_trapcc(DisasContext *s, DisasCompare *c)
+{
+    TCGv cond, ilen;
+
+    if (c->tcond == TCG_COND_NEVER) {
+        return;
+    }
+    /* The helper finds the flags in CC_OP_FLAGS form.  */
+    gen_flush_flags(s);
+    cond = tcg_temp_new();
+    tcg_gen_setcond_i32(c->tcond, cond, c->v1, c->v2);
+    ilen = tcg_const_i32(s->pc - s->insn_pc);
+    gen_helper_trapcc(cpu_env, cond, ilen);
+    tcg_temp_free(ilen);
+    tcg_temp_free(cond);
+}
+
+DISAS_INSN(trapcc)
+{
+    DisasCompare c;
+
+    if (!m68k_feature(env, M68K_FEATURE_EXT_FULL)) {
+        gen_exception(s, s->insn_pc, EXCP_ILLEGAL);
+        return;
+    }
+    /* The operand is only there for the trap handler.  */
+    switch (insn & 7) {
+    case 2:
+        read_im16(env, s);
+        break;
+    case 3:
+        read_im32(env, s);
+        break;
+    default:
+        break;
+    }
+    gen_cc_cond(&c, s, (insn >> 8) & 0xf);
+    gen_trapcc(s, &c);
+    free_cond(&c);
+}
+
+DISAS_INSN(trapv)
+{
+    DisasCompare c;
+
+    gen_cc_cond(&c, s, 9); /* VS */
+    gen_trapcc(s, &c);
+    free_cond(&c);
+}
+
 DISAS_INSN(dbcc)
 {
     TCGLabel *l1;
@@ -1557,11 +1657,50 @@ DISAS_INSN(mulw)
     tcg_temp_free(tmp);
 }
 
+/* Raise a divide-by-zero exception if DEN is zero.  This is a helper
+   call rather than a branch: a branch would end the TCG basic block
+   and force every live value of the divide out to memory.  The helper
+   recovers PC and cc_op from the insn_start data, and needs the length
+   of the instruction for the format 2 frame.  */
+static void gen_div0_check(DisasContext *s, TCGv den)
+{
+    TCGv ilen = tcg_const_i32(s->pc - s->insn_pc);
+
+    gen_helper_div0_check(cpu_env, den, ilen);
+    tcg_temp_free(ilen);
+}
+
+/* Set the flags after a divide.  OVF is 1 if the quotient overflowed,
+   in which case N is kept, Z is cleared and V is set.  */
+static void gen_div_flags(DisasContext *s, TCGv quot, TCGv ovf)
+{
+    TCGv zero = tcg_const_i32(0);
+
+    set_cc_op(s, CC_OP_FLAGS);
+    tcg_gen_movcond_i32(TCG_COND_NE, QREG_CC_N, ovf, zero, QREG_CC_N, quot);
+    tcg_gen_movcond_i32(TCG_COND_NE, QREG_CC_Z, ovf, zero, ovf, quot);
+    tcg_gen_neg_i32(QREG_CC_V, ovf);
+    tcg_gen_movi_i32(QREG_CC_C, 0); /* always cleared, even if overflow */
+    tcg_temp_free(zero);
+}
+
+/* Write VAL to REG unless OVF is set.  */
+static void gen_div_result(TCGv reg, TCGv val, TCGv ovf)
+{
+    TCGv zero = tcg_const_i32(0);
+
+    tcg_gen_movcond_i32(TCG_COND_NE, reg, ovf, zero, reg, val);
+    tcg_temp_free(zero);
+}
+
 DISAS_INSN(divw)
 {
     int sign;
     TCGv src;
-    TCGv destr;
+    TCGv den;
+    TCGv reg;
+    TCGv quot, rem, ovf;
+    TCGv t0;
 
     /* divX.w <EA>,Dn    32/16 -> 16r:16q */
 
@@ -1570,20 +1709,59 @@ DISAS_INSN(divw)
     /* dest.l / src.w */
 
     SRC_EA(env, src, OS_WORD, sign, NULL);
-    destr = tcg_const_i32(REG(insn, 9));
+    gen_div0_check(s, src);
+    den = tcg_temp_new();
+    tcg_gen_mov_i32(den, src);
+
+    reg = DREG(insn, 9);
+    quot = tcg_temp_new();
+    rem = tcg_temp_new();
+    ovf = tcg_temp_new();
+    t0 = tcg_temp_new();
     if (sign) {
-        gen_helper_divsw(cpu_env, destr, src);
+        /* 0x80000000 / -1 would trap on the host.  Its quotient does
+           not fit in 16 bits anyway, so divide by 1 instead and let
+           the overflow check below catch it.  */
+        tcg_gen_setcondi_i32(TCG_COND_EQ, ovf, reg, INT32_MIN);
+        tcg_gen_setcondi_i32(TCG_COND_EQ, t0, den, -1);
+        tcg_gen_and_i32(t0, t0, ovf);
+        tcg_gen_add_i32(t0, t0, t0);
+        tcg_gen_add_i32(den, den, t0);
+
+        tcg_gen_div_i32(quot, reg, den);
+        tcg_gen_ext16s_i32(t0, quot);
+        tcg_gen_setcond_i32(TCG_COND_NE, ovf, t0, quot);
     } else {
-        gen_helper_divuw(cpu_env, destr, src);
-    }
-    tcg_temp_free(destr);
+        tcg_gen_divu_i32(quot, reg, den);
+        tcg_gen_ext16s_i32(t0, quot);
+        tcg_gen_setcondi_i32(TCG_COND_GTU, ovf, quot, 0xffff);
+    }
+    /* Hosts divide once per div or rem op; derive the remainder
+       from the quotient rather than dividing a second time.  */
+    tcg_gen_mul_i32(rem, quot, den);
+    tcg_gen_sub_i32(rem, reg, rem);
+    tcg_temp_free(den);
+
+    /* real 68040 keeps N and unset Z on overflow,
+     * whereas documentation says "undefined"
+     */
+    gen_div_flags(s, t0, ovf);
 
-    set_cc_op(s, CC_OP_FLAGS);
+    tcg_gen_deposit_i32(quot, quot, rem, 16, 16);
+    gen_div_result(reg, quot, ovf);
+
+    tcg_temp_free(t0);
+    tcg_temp_free(ovf);
+    tcg_temp_free(rem);
+    tcg_temp_free(quot);
 }
 
 DISAS_INSN(divl)
 {
-    TCGv num, reg, den;
+    TCGv src, den;
+    TCGv num, reg;
+    TCGv quot, rem, ovf;
+    TCGv t0;
     int sign;
     uint16_t ext;
 
@@ -1591,43 +1769,115 @@ DISAS_INSN(divl)
 
     sign = (ext & 0x0800) != 0;
 
+    if ((ext & 0x400) && !m68k_feature(s->env, M68K_FEATURE_QUAD_MULDIV)) {
+        gen_exception(s, s->insn_pc, EXCP_ILLEGAL);
+        return;
+    }
+
+    SRC_EA(env, src, OS_LONG, 0, NULL);
+    gen_div0_check(s, src);
+    den = tcg_temp_new();
+    tcg_gen_mov_i32(den, src);
+
+    num = DREG(ext, 12);
+    reg = DREG(ext, 0);
+    quot = tcg_temp_new();
+    rem = tcg_temp_new();
+    ovf = tcg_temp_new();
+
     if (ext & 0x400) {
-        if (!m68k_feature(s->env, M68K_FEATURE_QUAD_MULDIV)) {
-            gen_exception(s, s->insn_pc, EXCP_ILLEGAL);
-            return;
-        }
+        TCGv_i64 num64, den64, quot64, rem64, t64;
 
         /* divX.l <EA>, Dr:Dq    64/32 -> 32r:32q */
 
-        SRC_EA(env, den, OS_LONG, 0, NULL);
-        num = tcg_const_i32(REG(ext, 12));
-        reg = tcg_const_i32(REG(ext, 0));
+        num64 = tcg_temp_new_i64();
+        den64 = tcg_temp_new_i64();
+        quot64 = tcg_temp_new_i64();
+        rem64 = tcg_temp_new_i64();
+        t64 = tcg_temp_new_i64();
+        tcg_gen_concat_i32_i64(num64, num, reg);
         if (sign) {
-            gen_helper_divsll(cpu_env, num, reg, den);
+            tcg_gen_ext_i32_i64(den64, den);
+            /* Avoid the host trap for INT64_MIN / -1, as in divw.  */
+            tcg_gen_setcondi_i64(TCG_COND_EQ, quot64, num64, INT64_MIN);
+            tcg_gen_setcondi_i64(TCG_COND_EQ, t64, den64, -1);
+            tcg_gen_and_i64(t64, t64, quot64);
+            tcg_gen_add_i64(t64, t64, t64);
+            tcg_gen_add_i64(den64, den64, t64);
+
+            tcg_gen_div_i64(quot64, num64, den64);
+            tcg_gen_ext32s_i64(t64, quot64);
+            tcg_gen_setcond_i64(TCG_COND_NE, t64, t64, quot64);
         } else {
-            gen_helper_divull(cpu_env, num, reg, den);
+            tcg_gen_extu_i32_i64(den64, den);
+            tcg_gen_divu_i64(quot64, num64, den64);
+            tcg_gen_setcondi_i64(TCG_COND_GTU, t64, quot64, 0xffffffffULL);
         }
-        tcg_temp_free(reg);
-        tcg_temp_free(num);
-        set_cc_op(s, CC_OP_FLAGS);
-        return;
+        tcg_gen_mul_i64(rem64, quot64, den64);
+        tcg_gen_sub_i64(rem64, num64, rem64);
+        tcg_gen_extrl_i64_i32(quot, quot64);
+        tcg_gen_extrl_i64_i32(rem, rem64);
+        tcg_gen_extrl_i64_i32(ovf, t64);
+        tcg_temp_free_i64(t64);
+        tcg_temp_free_i64(rem64);
+        tcg_temp_free_i64(quot64);
+        tcg_temp_free_i64(den64);
+        tcg_temp_free_i64(num64);
+        tcg_temp_free(den);
+
+        /* real 68040 keeps N and unset Z on overflow,
+         * whereas documentation says "undefined"
+         */
+        gen_div_flags(s, quot, ovf);
+
+        /*
+         * If Dq and Dr are the same, the quotient is returned.
+         * therefore we set Dq last.
+         */
+        gen_div_result(reg, rem, ovf);
+        gen_div_result(num, quot, ovf);
+        goto done;
     }
 
     /* divX.l <EA>, Dq        32/32 -> 32q     */
     /* divXl.l <EA>, Dr:Dq    32/32 -> 32r:32q */
 
-    SRC_EA(env, den, OS_LONG, 0, NULL);
-    num = tcg_const_i32(REG(ext, 12));
-    reg = tcg_const_i32(REG(ext, 0));
     if (sign) {
-        gen_helper_divsl(cpu_env, num, reg, den);
+        /* INT32_MIN / -1 overflows, and would trap on the host.  */
+        t0 = tcg_temp_new();
+        tcg_gen_setcondi_i32(TCG_COND_EQ, ovf, num, INT32_MIN);
+        tcg_gen_setcondi_i32(TCG_COND_EQ, t0, den, -1);
+        tcg_gen_and_i32(ovf, ovf, t0);
+        tcg_gen_add_i32(t0, ovf, ovf);
+        tcg_gen_add_i32(den, den, t0);
+        tcg_temp_free(t0);
+
+        tcg_gen_div_i32(quot, num, den);
     } else {
-        gen_helper_divul(cpu_env, num, reg, den);
+        tcg_gen_divu_i32(quot, num, den);
+        tcg_gen_movi_i32(ovf, 0);
     }
-    tcg_temp_free(reg);
-    tcg_temp_free(num);
+    tcg_gen_mul_i32(rem, quot, den);
+    tcg_gen_sub_i32(rem, num, rem);
+    tcg_temp_free(den);
 
-    set_cc_op(s, CC_OP_FLAGS);
+    gen_div_flags(s, quot, ovf);
+
+    if (m68k_feature(s->env, M68K_FEATURE_CF_ISA_A)) {
+        if (REG(ext, 12) == REG(ext, 0)) {
+            gen_div_result(num, quot, ovf);
+        } else {
+            gen_div_result(reg, rem, ovf);
+        }
+    } else {
+        gen_div_result(reg, rem, ovf);
+        gen_div_result(num, quot, ovf);
+    }
+
+done:
+    tcg_temp_free(ovf);
+    tcg_temp_free(rem);
+    tcg_temp_free(quot);
 }
 
 static void bcd_add(TCGv dest, TCGv src)
@@ -2020,6 +2270,7 @@ DISAS_INSN(movem)
 
     addr = tcg_temp_new();
     tcg_gen_mov_i32(addr, tmp);
+
     incr = tcg_const_i32(opsize_bytes(opsize));
 
     if (is_load) {
@@ -2307,7 +2558,7 @@ DISAS_INSN(cas2w)
                          (REG(ext1, 6) << 3) |
                          (REG(ext2, 0) << 6) |
                          (REG(ext1, 0) << 9));
-    if (tb_cflags(s->tb) & CF_PARALLEL) {
+    if (tb_cflags(s->base.tb) & CF_PARALLEL) {
         gen_helper_exit_atomic(cpu_env);
     } else {
         gen_helper_cas2w(cpu_env, regs, addr1, addr2);
@@ -2357,7 +2608,7 @@ DISAS_INSN(cas2l)
                          (REG(ext1, 6) << 3) |
                          (REG(ext2, 0) << 6) |
                          (REG(ext1, 0) << 9));
-    if (tb_cflags(s->tb) & CF_PARALLEL) {
+    if (tb_cflags(s->base.tb) & CF_PARALLEL) {
         gen_helper_cas2l_parallel(cpu_env, regs, addr1, addr2);
     } else {
         gen_helper_cas2l(cpu_env, regs, addr1, addr2);
@@ -2470,6 +2721,25 @@ DISAS_INSN(lea)
     tcg_gen_mov_i32(reg, tmp);
 }
 
+DISAS_INSN(chk)
+{
+    TCGv src, reg, ilen;
+    int opsize;
+
+    opsize = (insn & 0x80) ? OS_WORD : OS_LONG;
+    if (opsize == OS_LONG && !m68k_feature(env, M68K_FEATURE_EXT_FULL)) {
+        gen_exception(s, s->insn_pc, EXCP_ILLEGAL);
+        return;
+    }
+    SRC_EA(env, src, opsize, 1, NULL);
+    reg = gen_extend(DREG(insn, 9), opsize, 1);
+
+    gen_flush_flags(s);
+    ilen = tcg_const_i32(s->pc - s->insn_pc);
+    gen_helper_chk(cpu_env, reg, src, ilen);
+    tcg_temp_free(ilen);
+}
+
 DISAS_INSN(clr)
 {
     int opsize;
@@ -2900,9 +3170,20 @@ DISAS_INSN(branch)
         /* Bcc */
         l1 = gen_new_label();
         gen_jmpcc(s, ((insn >> 8) & 0xf) ^ 1, l1);
+        if (base + offset >= s->pc && superblock_follow(s, s->pc)) {
+            /* Predict forward branches not taken, and carry on with
+               the next insn in the superblock.  */
+            gen_side_exit(s, base + offset);
+            gen_set_label(l1);
+            return;
+        }
         gen_jmp_tb(s, 1, base + offset);
         gen_set_label(l1);
         gen_jmp_tb(s, 0, s->pc);
+    } else if (superblock_follow(s, base + offset)) {
+        /* Translate the destination in this TB, where the CPU state
+           stays in host registers and the CC_OP remains known.  */
+        s->pc = base + offset;
     } else {
         /* Unconditional branch.  */
         update_cc_op(s);
@@ -3906,6 +4187,159 @@ DISAS_INSN(bfext_reg)
     set_cc_op(s, CC_OP_LOGIC);
 }
 
+/* Load the BLEN + 1 bytes at ADDR, big-endian, into the low bits of
+   a 64-bit value.  Lengths that are not a power of two are split into
+   pieces so that no byte outside the field is accessed.  */
+static TCGv_i64 gen_bf_load(DisasContext *s, TCGv addr, int blen)
+{
+    TCGv_i64 data = tcg_temp_new_i64();
+    TCGv_i64 t64;
+    TCGv tmp;
+
+    switch (blen) {
+    case 0:
+        tmp = gen_load(s, OS_BYTE, addr, 0);
+        break;
+    case 1:
+        tmp = gen_load(s, OS_WORD, addr, 0);
+        break;
+    case 3:
+        tmp = gen_load(s, OS_LONG, addr, 0);
+        break;
+    case 2:
+    case 4:
+        tmp = gen_load(s, blen == 2 ? OS_WORD : OS_LONG, addr, 0);
+        tcg_gen_extu_i32_i64(data, tmp);
+        tcg_gen_shli_i64(data, data, 8);
+        tcg_temp_free(tmp);
+
+        tmp = tcg_temp_new();
+        tcg_gen_addi_i32(tmp, addr, blen);
+        t64 = tcg_temp_new_i64();
+        tcg_gen_qemu_ld_i64(t64, tmp, IS_USER(s), MO_UB);
+        gen_throws_exception = gen_last_qop;
+        tcg_gen_or_i64(data, data, t64);
+        tcg_temp_free_i64(t64);
+        tcg_temp_free(tmp);
+        return data;
+    default:
+        g_assert_not_reached();
+    }
+    tcg_gen_extu_i32_i64(data, tmp);
+    tcg_temp_free(tmp);
+    return data;
+}
+
+static void gen_bf_store(DisasContext *s, TCGv addr, int blen, TCGv_i64 data)
+{
+    TCGv tmp = tcg_temp_new();
+
+    switch (blen) {
+    case 0:
+        tcg_gen_extrl_i64_i32(tmp, data);
+        gen_store(s, OS_BYTE, addr, tmp);
+        break;
+    case 1:
+        tcg_gen_extrl_i64_i32(tmp, data);
+        gen_store(s, OS_WORD, addr, tmp);
+        break;
+    case 3:
+        tcg_gen_extrl_i64_i32(tmp, data);
+        gen_store(s, OS_LONG, addr, tmp);
+        break;
+    case 2:
+    case 4:
+        {
+            TCGv_i64 t64 = tcg_temp_new_i64();
+
+            /* Store in address order, as an unaligned store would.  */
+            tcg_gen_shri_i64(t64, data, 8);
+            tcg_gen_extrl_i64_i32(tmp, t64);
+            gen_store(s, blen == 2 ? OS_WORD : OS_LONG, addr, tmp);
+            tcg_temp_free_i64(t64);
+
+            tcg_gen_addi_i32(tmp, addr, blen);
+            tcg_gen_qemu_st_i64(data, tmp, IS_USER(s), MO_UB);
+            gen_throws_exception = gen_last_qop;
+        }
+        break;
+    default:
+        g_assert_not_reached();
+    }
+    tcg_temp_free(tmp);
+}
+
+/* Memory bitfield operation with immediate offset and width.  The bytes
+   covering the field are known at translation time, so the whole
+   operation is expanded inline.  */
+static void gen_bfop_mem_im(DisasContext *s, uint16_t insn, int ext,
+                            TCGv addr)
+{
+    int len = ((extract32(ext, 0, 5) - 1) & 31) + 1;
+    int ofs = extract32(ext, 6, 5);  /* big bit-endian */
+    int bofs = ofs & 7;
+    int blen = (bofs + len - 1) / 8;
+    int pos = 8 * (blen + 1) - bofs - len;  /* little bit-endian */
+    uint64_t mask = MAKE_64BIT_MASK(pos, len);
+    TCGv reg = DREG(ext, 12);
+    TCGv_i64 data, field;
+    TCGv ea;
+
+    ea = tcg_temp_new();
+    tcg_gen_addi_i32(ea, addr, ofs >> 3);
+    data = gen_bf_load(s, ea, blen);
+
+    /* CC_N holds the field at the top of the word for CC_OP_LOGIC.  */
+    field = tcg_temp_new_i64();
+    if ((insn & 0x0f00) == 0x0f00) { /* bfins */
+        tcg_gen_shli_i32(QREG_CC_N, reg, 32 - len);
+    } else {
+        tcg_gen_extract_i64(field, data, pos, len);
+        tcg_gen_extrl_i64_i32(QREG_CC_N, field);
+        tcg_gen_shli_i32(QREG_CC_N, QREG_CC_N, 32 - len);
+    }
+    set_cc_op(s, CC_OP_LOGIC);
+
+    switch (insn & 0x0f00) {
+    case 0x0900: /* bfextu */
+        tcg_gen_extrl_i64_i32(reg, field);
+        break;
+    case 0x0b00: /* bfexts */
+        tcg_gen_sari_i32(reg, QREG_CC_N, 32 - len);
+        break;
+    case 0x0a00: /* bfchg */
+        tcg_gen_xori_i64(data, data, mask);
+        gen_bf_store(s, ea, blen, data);
+        break;
+    case 0x0c00: /* bfclr */
+        tcg_gen_andi_i64(data, data, ~mask);
+        gen_bf_store(s, ea, blen, data);
+        break;
+    case 0x0d00: /* bfffo */
+        tcg_gen_clzi_i32(reg, QREG_CC_N, len);
+        tcg_gen_addi_i32(reg, reg, ofs);
+        break;
+    case 0x0e00: /* bfset */
+        tcg_gen_ori_i64(data, data, mask);
+        gen_bf_store(s, ea, blen, data);
+        break;
+    case 0x0f00: /* bfins */
+        tcg_gen_extu_i32_i64(field, reg);
+        tcg_gen_deposit_i64(data, data, field, pos, len);
+        gen_bf_store(s, ea, blen, data);
+        break;
+    case 0x0800: /* bftst */
+        /* flags already set; no other work to do.  */
+        break;
+    default:
+        g_assert_not_reached();
+    }
+
+    tcg_temp_free_i64(field);
+    tcg_temp_free_i64(data);
+    tcg_temp_free(ea);
+}
+
 DISAS_INSN(bfext_mem)
 {
     int ext = read_im16(env, s);
@@ -3919,6 +4353,12 @@ DISAS_INSN(bfext_mem)
         return;
     }
 
+    if ((ext & 0x820) == 0) {
+        /* Immediate width and offset.  */
+        gen_bfop_mem_im(s, insn, ext, addr);
+        return;
+    }
+
     if (ext & 0x20) {
         len = DREG(ext, 0);
     } else {
@@ -4054,6 +4494,12 @@ DISAS_INSN(bfop_mem)
         return;
     }
 
+    if ((ext & 0x820) == 0) {
+        /* Immediate width and offset.  */
+        gen_bfop_mem_im(s, insn, ext, addr);
+        return;
+    }
+
     if (ext & 0x20) {
         len = DREG(ext, 0);
     } else {
@@ -4183,6 +4629,12 @@ DISAS_INSN(bfins_mem)
         return;
     }
 
+    if ((ext & 0x820) == 0) {
+        /* Immediate width and offset.  */
+        gen_bfop_mem_im(s, insn, ext, addr);
+        return;
+    }
+
     if (ext & 0x20) {
         len = DREG(ext, 0);
     } else {
@@ -4338,6 +4790,31 @@ DISAS_INSN(movec)
     gen_lookup_tb(s);
 }
 
+DISAS_INSN(m68k_movec)
+{
+    uint16_t ext;
+    TCGv reg;
+
+    if (IS_USER(s)) {
+        gen_exception(s, s->pc - 2, EXCP_PRIVILEGE);
+        return;
+    }
+
+    ext = read_im16(env, s);
+
+    if (ext & 0x8000) {
+        reg = AREG(ext, 12);
+    } else {
+        reg = DREG(ext, 12);
+    }
+    if (insn & 1) {
+        gen_helper_m68k_movec_to(cpu_env, tcg_const_i32(ext & 0xfff), reg);
+    } else {
+        gen_helper_m68k_movec_from(reg, cpu_env, tcg_const_i32(ext & 0xfff));
+    }
+    gen_lookup_tb(s);
+}
+
 DISAS_INSN(intouch)
 {
     if (IS_USER(s)) {
@@ -4356,6 +4833,36 @@ DISAS_INSN(cpushl)
     /* Cache push/invalidate.  Implement as no-op.  */
 }
 
+#if defined(CONFIG_SOFTMMU)
+DISAS_INSN(pflush)
+{
+    TCGv opmode;
+
+    if (IS_USER(s)) {
+        gen_exception(s, s->pc - 2, EXCP_PRIVILEGE);
+        return;
+    }
+
+    opmode = tcg_const_i32((insn >> 3) & 3);
+    gen_helper_pflush(cpu_env, AREG(insn, 0), opmode);
+    tcg_temp_free(opmode);
+    gen_lookup_tb(s);
+}
+
+DISAS_INSN(ptest)
+{
+    TCGv is_read;
+
+    if (IS_USER(s)) {
+        gen_exception(s, s->pc - 2, EXCP_PRIVILEGE);
+        return;
+    }
+    is_read = tcg_const_i32((insn >> 5) & 1);
+    gen_helper_ptest(cpu_env, AREG(insn, 0), is_read);
+    tcg_temp_free(is_read);
+}
+#endif
+
 DISAS_INSN(wddata)
 {
     gen_exception(s, s->pc - 2, EXCP_PRIVILEGE);
@@ -4375,6 +4882,40 @@ DISAS_INSN(wdebug)
 
 DISAS_INSN(trap)
 {
+#if defined(CONFIG_USER_ONLY)
+    if ((insn & 0xf) == 0) {
+        /* The syscalls below are issued very often by glibc, and are
+           handled here rather than by leaving the cpu loop to go
+           through do_syscall.  */
+        TCGLabel *l_tp = gen_new_label();
+        TCGLabel *l_cas = gen_new_label();
+        TCGLabel *l_done = gen_new_label();
+
+        update_cc_op(s);
+        tcg_gen_brcondi_i32(TCG_COND_EQ, cpu_dregs[0],
+                            TARGET_NR_get_thread_area, l_tp);
+        tcg_gen_brcondi_i32(TCG_COND_EQ, cpu_dregs[0],
+                            TARGET_NR_atomic_cmpxchg_32, l_cas);
+        tcg_gen_movi_i32(QREG_PC, s->insn_pc);
+        gen_raise_exception(EXCP_TRAP0);
+
+        /* get_thread_area only returns the thread pointer.  */
+        gen_set_label(l_tp);
+        tcg_gen_ld_i32(cpu_dregs[0], cpu_env,
+                       offsetof(CPUM68KState, tp_value));
+        tcg_gen_br(l_done);
+
+        /* atomic_cmpxchg_32 (newval in D1, oldval in D2, address in A0)
+           returns the old memory contents.  A bad address raises
+           SIGSEGV at the TRAP instruction.  */
+        gen_set_label(l_cas);
+        tcg_gen_atomic_cmpxchg_i32(cpu_dregs[0], cpu_aregs[0], cpu_dregs[2],
+                                   cpu_dregs[1], IS_USER(s), MO_TEUL);
+
+        gen_set_label(l_done);
+        return;
+    }
+#endif
     gen_exception(s, s->pc - 2, EXCP_TRAP0 + (insn & 0xf));
 }
 
@@ -4393,6 +4934,19 @@ static void gen_load_fcr(DisasContext *s, TCGv res, int reg)
     }
 }
 
+/* Return the temp that receives the float_relation returned by the fcmp
+   and ftst helpers.  It lets FBcc and FScc later in the TB test the
+   condition without reloading FPSR.  The helpers still update FPSR.  */
+static TCGv gen_fpcc_dest(DisasContext *s)
+{
+    if (TCGV_IS_UNUSED(s->fpcc)) {
+        /* Must survive the branches generated by other insns.  */
+        s->fpcc = tcg_temp_local_new();
+    }
+    s->fpcc_valid = 1;
+    return s->fpcc;
+}
+
 static void gen_store_fcr(DisasContext *s, TCGv val, int reg)
 {
     switch (reg) {
@@ -4400,6 +4954,7 @@ static void gen_store_fcr(DisasContext *s, TCGv val, int reg)
         break;
     case M68K_FPSR:
         gen_helper_update_fpstatus(cpu_env, val);
+        s->fpcc_valid = 0;
         break;
     case M68K_FPCR:
         gen_helper_set_fpcr(cpu_env, val);
@@ -4606,7 +5161,7 @@ DISAS_INSN(fpu)
         if (gen_ea_fp(env, s, insn, opsize, cpu_src, EA_STORE) == -1) {
             gen_addr_fault(s);
         }
-        gen_helper_ftst(cpu_env, cpu_src);
+        gen_helper_ftst(gen_fpcc_dest(s), cpu_env, cpu_src);
         tcg_temp_free_ptr(cpu_src);
         return;
     case 4: /* fmove to control register.  */
@@ -4795,16 +5350,16 @@ DISAS_INSN(fpu)
         }
         break;
     case 0x38: /* fcmp */
-        gen_helper_fcmp(cpu_env, cpu_src, cpu_dest);
+        gen_helper_fcmp(gen_fpcc_dest(s), cpu_env, cpu_src, cpu_dest);
         return;
     case 0x3a: /* ftst */
-        gen_helper_ftst(cpu_env, cpu_src);
+        gen_helper_ftst(gen_fpcc_dest(s), cpu_env, cpu_src);
         return;
     default:
         goto undef;
     }
     tcg_temp_free_ptr(cpu_src);
-    gen_helper_ftst(cpu_env, cpu_dest);
+    gen_helper_ftst(gen_fpcc_dest(s), cpu_env, cpu_dest);
     tcg_temp_free_ptr(cpu_dest);
     return;
 undef:
@@ -4813,10 +5368,57 @@ undef:
     disas_undef_fpu(env, s, insn);
 }
 
+/* Test COND against the float_relation in S->FPCC: -1 less, 0 equal,
+   1 greater, 2 unordered.  The predicates only depend on A, Z and N, and
+   Z takes precedence over N, so the relation is all that matters.  */
+static void gen_fcc_cond_rel(DisasCompare *c, DisasContext *s, int cond)
+{
+    static const struct {
+        TCGCond tcond;
+        int32_t val;
+    } rel_cond[16] = {
+        [0] = { TCG_COND_NEVER, 0 },   /* False */
+        [1] = { TCG_COND_EQ, 0 },      /* EQual Z */
+        [2] = { TCG_COND_EQ, 1 },      /* Ordered Greater Than */
+        [3] = { TCG_COND_LEU, 1 },     /* Ordered Greater than or Equal */
+        [4] = { TCG_COND_EQ, -1 },     /* Ordered Less Than */
+        [5] = { TCG_COND_LE, 0 },      /* Ordered Less than or Equal */
+        [6] = { TCG_COND_NE, 0 },      /* Ordered Greater or Less than */
+        [7] = { TCG_COND_NE, 2 },      /* Ordered */
+        [8] = { TCG_COND_EQ, 2 },      /* Unordered */
+        [9] = { TCG_COND_EQ, 0 },      /* Unordered or Equal */
+        [10] = { TCG_COND_GT, 0 },     /* Unordered or Greater Than */
+        [11] = { TCG_COND_GE, 0 },     /* Unordered or Greater or Equal */
+        [12] = { TCG_COND_GEU, 2 },    /* Unordered or Less Than */
+        [13] = { TCG_COND_NE, 1 },     /* Unordered or Less or Equal */
+        [14] = { TCG_COND_NE, 0 },     /* Not Equal */
+        [15] = { TCG_COND_ALWAYS, 0 }, /* True */
+    };
+
+    cond &= 15;
+    c->tcond = rel_cond[cond].tcond;
+    c->v2 = tcg_const_i32(rel_cond[cond].val);
+    c->g2 = 0;
+    if (cond == 6 || cond == 9) {
+        /* Bit 0 of the relation is set for less and greater.  */
+        c->v1 = tcg_temp_new();
+        c->g1 = 0;
+        tcg_gen_andi_i32(c->v1, s->fpcc, 1);
+    } else {
+        c->v1 = s->fpcc;
+        c->g1 = 1;
+    }
+}
+
 static void gen_fcc_cond(DisasCompare *c, DisasContext *s, int cond)
 {
     TCGv fpsr;
 
+    if (s->fpcc_valid && cond < 32) {
+        gen_fcc_cond_rel(c, s, cond);
+        return;
+    }
+
     c->g1 = 1;
     c->v2 = tcg_const_i32(0);
     c->g2 = 0;
@@ -5047,6 +5649,165 @@ static void gen_mac_clear_flags(void)
                      ~(MACSR_V | MACSR_Z | MACSR_N | MACSR_EV));
 }
 
+/* MACSR |= BIT if FLAG, where FLAG is 0 or 1.  */
+static void gen_macsr_set(TCGv_i64 flag, uint32_t bit)
+{
+    TCGv tmp = tcg_temp_new();
+
+    tcg_gen_extrl_i64_i32(tmp, flag);
+    tcg_gen_shli_i32(tmp, tmp, ctz32(bit));
+    tcg_gen_or_i32(QREG_MACSR, QREG_MACSR, tmp);
+    tcg_temp_free(tmp);
+}
+
+/* Multiply RX by RY into DEST, setting MACSR_V if the product does not
+   fit in 40 bits.  The MAC mode is fixed at translation time.  */
+static void gen_mac_mul(DisasContext *s, TCGv_i64 dest, TCGv rx, TCGv ry)
+{
+    TCGv lo, hi;
+    TCGv_i64 res, ovf, zero;
+
+    if (s->env->macsr & MACSR_FI) {
+        gen_helper_macmulf(dest, cpu_env, rx, ry);
+        return;
+    }
+
+    lo = tcg_temp_new();
+    hi = tcg_temp_new();
+    tcg_gen_mulu2_i32(lo, hi, rx, ry);
+    tcg_gen_concat_i32_i64(dest, lo, hi);
+    tcg_temp_free(hi);
+    tcg_temp_free(lo);
+
+    res = tcg_temp_new_i64();
+    ovf = tcg_temp_new_i64();
+    zero = tcg_const_i64(0);
+    if (s->env->macsr & MACSR_SU) {
+        tcg_gen_shli_i64(res, dest, 24);
+        tcg_gen_sari_i64(res, res, 24);
+        tcg_gen_setcond_i64(TCG_COND_NE, ovf, res, dest);
+        gen_macsr_set(ovf, MACSR_V);
+        if (s->env->macsr & MACSR_OMC) {
+            /* Make sure the accumulate operation overflows.  */
+            tcg_gen_sari_i64(ovf, dest, 63);
+            tcg_gen_xori_i64(ovf, ovf, 1ll << 50);
+            tcg_gen_movcond_i64(TCG_COND_NE, dest, res, dest, ovf, res);
+        } else {
+            tcg_gen_mov_i64(dest, res);
+        }
+    } else {
+        tcg_gen_shri_i64(res, dest, 40);
+        tcg_gen_setcondi_i64(TCG_COND_NE, ovf, res, 0);
+        gen_macsr_set(ovf, MACSR_V);
+        if (s->env->macsr & MACSR_OMC) {
+            /* Make sure the accumulate operation overflows.  */
+            tcg_gen_movi_i64(res, 1ll << 50);
+            tcg_gen_movcond_i64(TCG_COND_NE, dest, ovf, zero, res, dest);
+        } else {
+            tcg_gen_andi_i64(dest, dest, (1ull << 40) - 1);
+        }
+    }
+    tcg_temp_free_i64(zero);
+    tcg_temp_free_i64(ovf);
+    tcg_temp_free_i64(res);
+}
+
+/* Saturate accumulator ACC after an accumulate operation.  */
+static void gen_mac_sat(DisasContext *s, int acc)
+{
+    TCGv_i64 val = MACREG(acc);
+    TCGv_i64 res, ovf, sat, zero;
+    TCGv tmp;
+
+    if (s->env->macsr & MACSR_FI) {
+        gen_helper_macsatf(cpu_env, tcg_const_i32(acc));
+        return;
+    }
+
+    res = tcg_temp_new_i64();
+    ovf = tcg_temp_new_i64();
+    if (s->env->macsr & MACSR_SU) {
+        tcg_gen_shli_i64(res, val, 16);
+        tcg_gen_sari_i64(res, res, 16);
+        tcg_gen_setcond_i64(TCG_COND_NE, ovf, res, val);
+    } else {
+        tcg_gen_mov_i64(res, val);
+        tcg_gen_shri_i64(ovf, val, 48);
+        tcg_gen_setcondi_i64(TCG_COND_NE, ovf, ovf, 0);
+    }
+    gen_macsr_set(ovf, MACSR_V);
+
+    /* Any overflow, including one from the multiply, marks the
+       accumulator as having overflowed.  */
+    tmp = tcg_temp_new();
+    tcg_gen_andi_i32(tmp, QREG_MACSR, MACSR_V);
+    tcg_gen_shli_i32(tmp, tmp, ctz32(MACSR_PAV0 << acc) - ctz32(MACSR_V));
+    tcg_gen_or_i32(QREG_MACSR, QREG_MACSR, tmp);
+    tcg_gen_extu_i32_i64(ovf, tmp);
+    tcg_temp_free(tmp);
+
+    sat = tcg_temp_new_i64();
+    if (s->env->macsr & MACSR_SU) {
+        if (s->env->macsr & MACSR_OMC) {
+            /* The result is saturated to 32 bits, despite overflow occurring
+               at 48 bits.  Seems weird, but that's what the hardware docs
+               say.  */
+            tcg_gen_sari_i64(sat, res, 63);
+            tcg_gen_xori_i64(sat, sat, 0x7fffffff);
+        } else {
+            tcg_gen_mov_i64(sat, res);
+        }
+    } else {
+        if (s->env->macsr & MACSR_OMC) {
+            tcg_gen_setcondi_i64(TCG_COND_LEU, sat, res, 1ull << 53);
+            tcg_gen_muli_i64(sat, sat, (1ull << 48) - 1);
+        } else {
+            tcg_gen_andi_i64(sat, res, (1ull << 48) - 1);
+        }
+    }
+    zero = tcg_const_i64(0);
+    tcg_gen_movcond_i64(TCG_COND_NE, val, ovf, zero, sat, res);
+
+    tcg_temp_free_i64(zero);
+    tcg_temp_free_i64(sat);
+    tcg_temp_free_i64(ovf);
+    tcg_temp_free_i64(res);
+}
+
+/* Set the MACSR N, Z, V and EV flags from accumulator ACC.  The flags
+   must have been cleared first.  */
+static void gen_mac_set_flags(DisasContext *s, int acc)
+{
+    TCGv_i64 val = MACREG(acc);
+    TCGv_i64 flag;
+    TCGv tmp;
+
+    if (s->env->macsr & MACSR_FI) {
+        gen_helper_mac_set_flags(cpu_env, tcg_const_i32(acc));
+        return;
+    }
+
+    flag = tcg_temp_new_i64();
+    tcg_gen_setcondi_i64(TCG_COND_EQ, flag, val, 0);
+    gen_macsr_set(flag, MACSR_Z);
+    tcg_gen_extract_i64(flag, val, 47, 1);
+    gen_macsr_set(flag, MACSR_N);
+    if (s->env->macsr & MACSR_SU) {
+        tcg_gen_ext32s_i64(flag, val);
+        tcg_gen_setcond_i64(TCG_COND_NE, flag, flag, val);
+    } else {
+        tcg_gen_setcondi_i64(TCG_COND_GTU, flag, val, 0xffffffffull);
+    }
+    gen_macsr_set(flag, MACSR_EV);
+    tcg_temp_free_i64(flag);
+
+    tmp = tcg_temp_new();
+    tcg_gen_extract_i32(tmp, QREG_MACSR, ctz32(MACSR_PAV0 << acc), 1);
+    tcg_gen_shli_i32(tmp, tmp, ctz32(MACSR_V));
+    tcg_gen_or_i32(QREG_MACSR, QREG_MACSR, tmp);
+    tcg_temp_free(tmp);
+}
+
 DISAS_INSN(mac)
 {
     TCGv rx;
@@ -5108,13 +5869,8 @@ DISAS_INSN(mac)
         rx = gen_mac_extract_word(s, rx, (ext & 0x80) != 0);
         ry = gen_mac_extract_word(s, ry, (ext & 0x40) != 0);
     }
-    if (s->env->macsr & MACSR_FI) {
-        gen_helper_macmulf(s->mactmp, cpu_env, rx, ry);
-    } else {
-        if (s->env->macsr & MACSR_SU)
-            gen_helper_macmuls(s->mactmp, cpu_env, rx, ry);
-        else
-            gen_helper_macmulu(s->mactmp, cpu_env, rx, ry);
+    gen_mac_mul(s, s->mactmp, rx, ry);
+    if (!(s->env->macsr & MACSR_FI)) {
         switch ((ext >> 9) & 3) {
         case 1:
             tcg_gen_shli_i64(s->mactmp, s->mactmp, 1);
@@ -5149,12 +5905,7 @@ DISAS_INSN(mac)
     else
         tcg_gen_add_i64(MACREG(acc), MACREG(acc), s->mactmp);
 
-    if (s->env->macsr & MACSR_FI)
-        gen_helper_macsatf(cpu_env, tcg_const_i32(acc));
-    else if (s->env->macsr & MACSR_SU)
-        gen_helper_macsats(cpu_env, tcg_const_i32(acc));
-    else
-        gen_helper_macsatu(cpu_env, tcg_const_i32(acc));
+    gen_mac_sat(s, acc);
 
 #if 0
     /* Disabled because conditional branches clobber temporary vars.  */
@@ -5181,19 +5932,14 @@ DISAS_INSN(mac)
             tcg_gen_sub_i64(MACREG(acc), MACREG(acc), s->mactmp);
         else
             tcg_gen_add_i64(MACREG(acc), MACREG(acc), s->mactmp);
-        if (s->env->macsr & MACSR_FI)
-            gen_helper_macsatf(cpu_env, tcg_const_i32(acc));
-        else if (s->env->macsr & MACSR_SU)
-            gen_helper_macsats(cpu_env, tcg_const_i32(acc));
-        else
-            gen_helper_macsatu(cpu_env, tcg_const_i32(acc));
+        gen_mac_sat(s, acc);
 #if 0
         /* Disabled because conditional branches clobber temporary vars.  */
         if (l1 != -1)
             gen_set_label(l1);
 #endif
     }
-    gen_helper_mac_set_flags(cpu_env, tcg_const_i32(acc));
+    gen_mac_set_flags(s, acc);
 
     if (insn & 0x30) {
         TCGv rw;
@@ -5244,7 +5990,7 @@ DISAS_INSN(move_mac)
     dest = tcg_const_i32((insn >> 9) & 3);
     gen_helper_mac_move(cpu_env, dest, tcg_const_i32(src));
     gen_mac_clear_flags();
-    gen_helper_mac_set_flags(cpu_env, dest);
+    gen_mac_set_flags(s, (insn >> 9) & 3);
 }
 
 DISAS_INSN(from_macsr)
@@ -5301,7 +6047,7 @@ DISAS_INSN(to_mac)
     }
     tcg_gen_andi_i32(QREG_MACSR, QREG_MACSR, ~(MACSR_PAV0 << accnum));
     gen_mac_clear_flags();
-    gen_helper_mac_set_flags(cpu_env, tcg_const_i32(accnum));
+    gen_mac_set_flags(s, accnum);
 }
 
 DISAS_INSN(to_macsr)
@@ -5333,7 +6079,32 @@ DISAS_INSN(to_mext)
         gen_helper_set_mac_extu(cpu_env, val, acc);
 }
 
-static disas_proc opcode_table[65536];
+/* The decoder is a two-level table.  The low OPCODE_L2_BITS of the
+   opcode (the effective address field for most instructions) index a
+   block of handler numbers; the remaining high bits select the block
+   through opcode_l1.  Identical blocks are shared, which keeps the
+   whole decoder in a few tens of KiB instead of a flat 64K-entry
+   table of pointers.  */
+#define OPCODE_L2_BITS  6
+#define OPCODE_L2_SIZE  (1 << OPCODE_L2_BITS)
+#define OPCODE_L1_SIZE  (0x10000 >> OPCODE_L2_BITS)
+
+typedef uint8_t OpcodeBlock[OPCODE_L2_SIZE];
+
+static disas_proc opcode_procs[256];
+static unsigned int opcode_nb_procs;
+static uint16_t opcode_l1[OPCODE_L1_SIZE];
+static OpcodeBlock *opcode_l2;
+
+/* Flat table, only used while registering opcodes.  */
+static disas_proc *opcode_build;
+
+static inline disas_proc opcode_lookup(uint16_t insn)
+{
+    const uint8_t *block = opcode_l2[opcode_l1[insn >> OPCODE_L2_BITS]];
+
+    return opcode_procs[block[insn & (OPCODE_L2_SIZE - 1)]];
+}
 
 static void
 register_opcode (disas_proc proc, uint16_t opcode, uint16_t mask)
@@ -5364,19 +6135,62 @@ register_opcode (disas_proc proc, uint16_t opcode, uint16_t mask)
   to = from + i;
   for (i = from; i < to; i++) {
       if ((i & mask) == opcode)
-          opcode_table[i] = proc;
+          opcode_build[i] = proc;
   }
 }
 
+static unsigned int opcode_proc_index(disas_proc proc)
+{
+    unsigned int i;
+
+    for (i = 0; i < opcode_nb_procs; i++) {
+        if (opcode_procs[i] == proc) {
+            return i;
+        }
+    }
+    assert(opcode_nb_procs < ARRAY_SIZE(opcode_procs));
+    opcode_procs[opcode_nb_procs] = proc;
+    return opcode_nb_procs++;
+}
+
+/* Convert the flat opcode_build table into opcode_l1/opcode_l2.  */
+static void compress_opcode_table(void)
+{
+    OpcodeBlock *blocks;
+    unsigned int nb_blocks = 0;
+    unsigned int i, j;
+
+    blocks = g_new(OpcodeBlock, OPCODE_L1_SIZE);
+    for (i = 0; i < OPCODE_L1_SIZE; i++) {
+        uint8_t *block = blocks[nb_blocks];
+
+        for (j = 0; j < OPCODE_L2_SIZE; j++) {
+            disas_proc proc = opcode_build[(i << OPCODE_L2_BITS) | j];
+            block[j] = opcode_proc_index(proc);
+        }
+        for (j = 0; j < nb_blocks; j++) {
+            if (memcmp(blocks[j], block, OPCODE_L2_SIZE) == 0) {
+                break;
+            }
+        }
+        opcode_l1[i] = j;
+        if (j == nb_blocks) {
+            nb_blocks++;
+        }
+    }
+    opcode_l2 = g_renew(OpcodeBlock, blocks, nb_blocks);
+}
+
 /* Register m68k opcode handlers.  Order is important.
    Later insn override earlier ones.  */
 void register_m68k_insns (CPUM68KState *env)
 {
     /* Build the opcode table only once to avoid
        multithreading issues. */
-    if (opcode_table[0] != NULL) {
+    if (opcode_l2 != NULL) {
         return;
     }
+    opcode_build = g_new0(disas_proc, 0x10000);
 
     /* use BASE() for instruction available
      * for CF_ISA_A and M68000.
@@ -5430,6 +6244,8 @@ void register_m68k_insns (CPUM68KState *env)
     INSN(move_from_sr, 40c0, fff8, CF_ISA_A);
     INSN(move_from_sr, 40c0, ffc0, M68000);
     BASE(lea,       41c0, f1c0);
+    INSN(chk,       4180, f1c0, M68000);
+    INSN(chk,       4100, f1c0, M68000);
     BASE(clr,       4200, ff00);
     BASE(undef,     42c0, ffc0);
     INSN(move_from_ccr, 42c0, fff8, CF_ISA_A);
@@ -5474,7 +6290,9 @@ void register_m68k_insns (CPUM68KState *env)
     BASE(rte,       4e73, ffff);
     INSN(rtd,       4e74, ffff, RTD);
     BASE(rts,       4e75, ffff);
+    INSN(trapv,     4e76, ffff, M68000);
     INSN(movec,     4e7b, ffff, CF_ISA_A);
+    INSN(m68k_movec, 4e7a, fffe, MOVEC);
     BASE(jump,      4e80, ffc0);
     BASE(jump,      4ec0, ffc0);
     INSN(addsubq,   5000, f080, M68000);
@@ -5482,6 +6300,8 @@ void register_m68k_insns (CPUM68KState *env)
     INSN(scc,       50c0, f0f8, CF_ISA_A); /* Scc.B Dx   */
     INSN(scc,       50c0, f0c0, M68000);   /* Scc.B <EA> */
     INSN(dbcc,      50c8, f0f8, M68000);
+    INSN(trapcc,    50fa, f0fe, M68000);
+    INSN(trapcc,    50fc, f0ff, M68000);
     INSN(tpf,       51f8, fff8, CF_ISA_A);
 
     /* Branch instructions.  */
@@ -5587,9 +6407,18 @@ void register_m68k_insns (CPUM68KState *env)
     INSN(fsave,     f300, ffc0, FPU);
     INSN(intouch,   f340, ffc0, CF_ISA_A);
     INSN(cpushl,    f428, ff38, CF_ISA_A);
+    INSN(cpushl,    f400, ff00, M68040_MMU); /* cinv, cpush */
+#if defined(CONFIG_SOFTMMU)
+    INSN(pflush,    f500, ffe0, M68040_MMU);
+    INSN(ptest,     f548, ffd8, M68040_MMU);
+#endif
     INSN(wddata,    fb00, ff00, CF_ISA_A);
     INSN(wdebug,    fbc0, ffc0, CF_ISA_A);
 #undef INSN
+
+    compress_opcode_table();
+    g_free(opcode_build);
+    opcode_build = NULL;
 }
 
 /* ??? Some of this implementation is not exception safe.  We should always
@@ -5597,115 +6426,162 @@ void register_m68k_insns (CPUM68KState *env)
 static void disas_m68k_insn(CPUM68KState * env, DisasContext *s)
 {
     uint16_t insn = read_im16(env, s);
-    opcode_table[insn](env, s, insn);
+    opcode_lookup(insn)(env, s, insn);
     do_writebacks(s);
 }
 
-/* generate intermediate code for basic block 'tb'.  */
-void gen_intermediate_code(CPUState *cs, TranslationBlock *tb)
+static int m68k_tr_init_disas_context(DisasContextBase *dcbase,
+                                      CPUState *cpu, int max_insns)
 {
-    CPUM68KState *env = cs->env_ptr;
-    DisasContext dc1, *dc = &dc1;
-    target_ulong pc_start;
-    int pc_offset;
-    int num_insns;
-    int max_insns;
-
-    /* generate intermediate code */
-    pc_start = tb->pc;
-
-    dc->tb = tb;
+    DisasContext *dc = container_of(dcbase, DisasContext, base);
+    CPUM68KState *env = cpu->env_ptr;
 
     dc->env = env;
-    dc->is_jmp = DISAS_NEXT;
-    dc->pc = pc_start;
+    dc->pc = dc->base.pc_first;
     dc->cc_op = CC_OP_DYNAMIC;
     dc->cc_op_synced = 1;
-    dc->singlestep_enabled = cs->singlestep_enabled;
     dc->user = (env->sr & SR_S) == 0;
+    dc->trace = (env->sr & SR_T) != 0;
     dc->done_mac = 0;
+    TCGV_UNUSED(dc->fpcc);
+    dc->fpcc_valid = 0;
     dc->writeback_mask = 0;
-    num_insns = 0;
-    max_insns = tb_cflags(tb) & CF_COUNT_MASK;
-    if (max_insns == 0) {
-        max_insns = CF_COUNT_MASK;
-    }
-    if (max_insns > TCG_MAX_INSNS) {
-        max_insns = TCG_MAX_INSNS;
-    }
-
-    gen_tb_start(tb);
-    do {
-        pc_offset = dc->pc - pc_start;
-        gen_throws_exception = NULL;
-        tcg_gen_insn_start(dc->pc, dc->cc_op);
-        num_insns++;
-
-        if (unlikely(cpu_breakpoint_test(cs, dc->pc, BP_ANY))) {
-            gen_exception(dc, dc->pc, EXCP_DEBUG);
-            dc->is_jmp = DISAS_JUMP;
-            /* The address covered by the breakpoint must be included in
-               [tb->pc, tb->pc + tb->size) in order to for it to be
-               properly cleared -- thus we increment the PC here so that
-               the logic setting tb->size below does the right thing.  */
-            dc->pc += 2;
-            break;
-        }
 
-        if (num_insns == max_insns && (tb_cflags(tb) & CF_LAST_IO)) {
-            gen_io_start();
+    /* ColdFire instructions are at most 6 bytes long.  The longest
+       680x0 instruction is a MOVE with full format extension words for
+       both operands, 22 bytes.  */
+    dc->max_insn_len = m68k_feature(env, M68K_FEATURE_M68000) ? 22 : 6;
+
+    /* Each traced instruction is followed by a trace exception.  */
+    if (dc->trace) {
+        max_insns = 1;
+    }
+    return max_insns;
+}
+
+static void m68k_tr_tb_start(DisasContextBase *dcbase, CPUState *cpu)
+{
+}
+
+static void m68k_tr_insn_start(DisasContextBase *dcbase, CPUState *cpu)
+{
+    DisasContext *dc = container_of(dcbase, DisasContext, base);
+
+    gen_throws_exception = NULL;
+    tcg_gen_insn_start(dc->base.pc_next, dc->cc_op);
+}
+
+static bool m68k_tr_breakpoint_check(DisasContextBase *dcbase, CPUState *cpu,
+                                     const CPUBreakpoint *bp)
+{
+    DisasContext *dc = container_of(dcbase, DisasContext, base);
+
+    gen_exception(dc, dc->base.pc_next, EXCP_DEBUG);
+    /* The address covered by the breakpoint must be included in
+       [tb->pc, tb->pc + tb->size) in order to for it to be
+       properly cleared -- thus we increment the PC here so that
+       the logic setting tb->size below does the right thing.  */
+    dc->base.pc_next += 2;
+
+    return true;
+}
+
+static void m68k_tr_translate_insn(DisasContextBase *dcbase, CPUState *cpu)
+{
+    DisasContext *dc = container_of(dcbase, DisasContext, base);
+    CPUM68KState *env = cpu->env_ptr;
+
+    dc->insn_pc = dc->pc;
+    disas_m68k_insn(env, dc);
+    dc->base.pc_next = dc->pc;
+
+    if (dc->base.is_jmp == DISAS_NEXT) {
+        /* A TB may run into the page after its first one, but no
+           further: tb_link_page tracks at most two pages per TB.  We
+           cannot know the size of the next insn without decoding it,
+           so stop once it might end more than a page past the start
+           of the TB.  */
+        if (dc->pc - dc->base.pc_first > TARGET_PAGE_SIZE - dc->max_insn_len) {
+            dc->base.is_jmp = DISAS_TOO_MANY;
         }
+    }
+}
+
+static void m68k_tr_tb_stop(DisasContextBase *dcbase, CPUState *cpu)
+{
+    DisasContext *dc = container_of(dcbase, DisasContext, base);
 
-        dc->insn_pc = dc->pc;
-	disas_m68k_insn(env, dc);
-    } while (!dc->is_jmp && !tcg_op_buf_full() &&
-             !cs->singlestep_enabled &&
-             !singlestep &&
-             (pc_offset) < (TARGET_PAGE_SIZE - 32) &&
-             num_insns < max_insns);
-
-    if (tb_cflags(tb) & CF_LAST_IO)
-        gen_io_end();
-    if (unlikely(cs->singlestep_enabled)) {
+    if (dc->base.is_jmp == DISAS_NORETURN) {
+        return;
+    }
+    if (unlikely(dc->base.singlestep_enabled)) {
         /* Make sure the pc is updated, and raise a debug exception.  */
-        if (!dc->is_jmp) {
+        if (dc->base.is_jmp == DISAS_NEXT ||
+            dc->base.is_jmp == DISAS_TOO_MANY) {
             update_cc_op(dc);
             tcg_gen_movi_i32(QREG_PC, dc->pc);
         }
-        gen_helper_raise_exception(cpu_env, tcg_const_i32(EXCP_DEBUG));
-    } else {
-        switch(dc->is_jmp) {
-        case DISAS_NEXT:
-            update_cc_op(dc);
-            gen_jmp_tb(dc, 0, dc->pc);
-            break;
-        default:
-        case DISAS_JUMP:
-        case DISAS_UPDATE:
-            update_cc_op(dc);
-            /* indicate that the hash table must be used to find the next TB */
-            tcg_gen_exit_tb(0);
-            break;
-        case DISAS_TB_JUMP:
-            /* nothing more to generate */
-            break;
-        }
+        gen_raise_exception(EXCP_DEBUG);
+        return;
+    }
+    if (unlikely(dc->trace) && (dc->base.is_jmp == DISAS_JUMP ||
+                                dc->base.is_jmp == DISAS_UPDATE)) {
+        /* The PC has been synced by gen_jmp/gen_jmp_im/gen_lookup_tb.  */
+        gen_raise_trace(dc);
+        return;
     }
-    gen_tb_end(tb, num_insns);
 
-#ifdef DEBUG_DISAS
-    if (qemu_loglevel_mask(CPU_LOG_TB_IN_ASM)
-        && qemu_log_in_addr_range(pc_start)) {
-        qemu_log_lock();
-        qemu_log("----------------\n");
-        qemu_log("IN: %s\n", lookup_symbol(pc_start));
-        log_target_disas(cs, pc_start, dc->pc - pc_start);
-        qemu_log("\n");
-        qemu_log_unlock();
+    switch (dc->base.is_jmp) {
+    case DISAS_NEXT:
+    case DISAS_TOO_MANY:
+        update_cc_op(dc);
+        gen_jmp_tb(dc, 0, dc->pc);
+        break;
+    case DISAS_JUMP:
+        /* The PC and CC_OP have been synced by gen_jmp; look up the
+           next TB without returning to the main loop.  */
+        update_cc_op(dc);
+        tcg_gen_lookup_and_goto_ptr();
+        break;
+    case DISAS_UPDATE:
+        update_cc_op(dc);
+        /* We updated CC_OP and PC in gen_jmp/gen_jmp_im/gen_lookup_tb.
+           The CPU state may have changed (e.g. SR), so return to the
+           main loop to recheck for pending interrupts.  */
+        tcg_gen_exit_tb(0);
+        break;
+    case DISAS_TB_JUMP:
+        /* nothing more to generate */
+        break;
+    default:
+        g_assert_not_reached();
     }
-#endif
-    tb->size = dc->pc - pc_start;
-    tb->icount = num_insns;
+}
+
+static void m68k_tr_disas_log(const DisasContextBase *dcbase, CPUState *cpu)
+{
+    /* A superblock skips over the code of the branches it followed.  */
+    qemu_log("IN: %s%s\n", lookup_symbol(dcbase->pc_first),
+             tb_cflags(dcbase->tb) & CF_HOT ? " (superblock)" : "");
+    log_target_disas(cpu, dcbase->pc_first, dcbase->tb->size);
+}
+
+static const TranslatorOps m68k_tr_ops = {
+    .init_disas_context = m68k_tr_init_disas_context,
+    .tb_start           = m68k_tr_tb_start,
+    .insn_start         = m68k_tr_insn_start,
+    .breakpoint_check   = m68k_tr_breakpoint_check,
+    .translate_insn     = m68k_tr_translate_insn,
+    .tb_stop            = m68k_tr_tb_stop,
+    .disas_log          = m68k_tr_disas_log,
+};
+
+/* generate intermediate code for basic block 'tb'.  */
+void gen_intermediate_code(CPUState *cpu, TranslationBlock *tb)
+{
+    DisasContext dc;
+
+    translator_loop(&m68k_tr_ops, &dc.base, cpu, tb);
 }
 
 static double floatx80_to_double(CPUM68KState *env, uint16_t high, uint64_t low)
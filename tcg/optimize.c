@@ -599,6 +599,334 @@ static bool swap_commutative2(TCGArg *p1, TCGArg *p2)
     return false;
 }
 
+/* Accesses to the CPU state through cpu_env, or through a pointer at a
+   known offset from it, tracked within a basic block.  A load of a field
+   that was stored or loaded earlier in the block reuses the temp that
+   holds it, and a store that is overwritten before anything may read it
+   is removed.  Helper calls, guest memory accesses (which may fault) and
+   the end of the block may read anything, so they keep all the stores
+   before them.  */
+
+#define ENV_MAX_VALUES 32
+#define ENV_MAX_PTRS   8
+
+typedef struct EnvValue {
+    intptr_t ofs;
+    int size;
+    TCGTemp *val;
+    TCGOpcode ld_opc;   /* the load that reads back val */
+} EnvValue;
+
+typedef struct EnvStore {
+    intptr_t ofs;
+    int size;
+    TCGOp *op;
+} EnvStore;
+
+typedef struct EnvPtr {
+    TCGTemp *ptr;
+    intptr_t ofs;
+} EnvPtr;
+
+typedef struct EnvState {
+    TCGTemp *env;
+    int nb_values;
+    int nb_stores;
+    int nb_ptrs;
+    EnvValue values[ENV_MAX_VALUES];
+    EnvStore stores[ENV_MAX_VALUES];
+    EnvPtr ptrs[ENV_MAX_PTRS];
+} EnvState;
+
+static void env_reset(EnvState *es)
+{
+    es->nb_values = 0;
+    es->nb_stores = 0;
+    es->nb_ptrs = 0;
+}
+
+/* Return the access size of a host load or store, 0 for other ops.  */
+static int env_op_size(TCGOpcode opc, bool *is_store)
+{
+    *is_store = false;
+    switch (opc) {
+    CASE_OP_32_64(ld8u):
+    CASE_OP_32_64(ld8s):
+        return 1;
+    CASE_OP_32_64(ld16u):
+    CASE_OP_32_64(ld16s):
+        return 2;
+    case INDEX_op_ld_i32:
+    case INDEX_op_ld32u_i64:
+    case INDEX_op_ld32s_i64:
+        return 4;
+    case INDEX_op_ld_i64:
+        return 8;
+    CASE_OP_32_64(st8):
+        *is_store = true;
+        return 1;
+    CASE_OP_32_64(st16):
+        *is_store = true;
+        return 2;
+    case INDEX_op_st_i32:
+    case INDEX_op_st32_i64:
+        *is_store = true;
+        return 4;
+    case INDEX_op_st_i64:
+        *is_store = true;
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+static bool env_base(EnvState *es, TCGTemp *ts, intptr_t *ofs)
+{
+    int i;
+
+    if (ts == es->env) {
+        *ofs = 0;
+        return true;
+    }
+    for (i = 0; i < es->nb_ptrs; i++) {
+        if (es->ptrs[i].ptr == ts) {
+            *ofs = es->ptrs[i].ofs;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool env_ranges_overlap(intptr_t ofs1, int size1,
+                               intptr_t ofs2, int size2)
+{
+    return ofs1 < ofs2 + size2 && ofs2 < ofs1 + size1;
+}
+
+/* The register allocator loads and stores globals behind our back.  */
+static bool env_overlaps_global(TCGContext *s, EnvState *es,
+                                intptr_t ofs, int size)
+{
+    int i;
+
+    for (i = 0; i < s->nb_globals; i++) {
+        TCGTemp *ts = &s->temps[i];
+
+        if (ts->mem_base == es->env &&
+            env_ranges_overlap(ofs, size, ts->mem_offset,
+                               ts->type == TCG_TYPE_I32 ? 4 : 8)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void env_remove_value(EnvState *es, int i)
+{
+    es->values[i] = es->values[--es->nb_values];
+}
+
+static void env_remove_store(EnvState *es, int i)
+{
+    es->stores[i] = es->stores[--es->nb_stores];
+}
+
+/* TS is assigned a new value.  */
+static void env_forget_temp(EnvState *es, TCGTemp *ts)
+{
+    int i;
+
+    for (i = es->nb_values - 1; i >= 0; i--) {
+        if (es->values[i].val == ts) {
+            env_remove_value(es, i);
+        }
+    }
+    for (i = es->nb_ptrs - 1; i >= 0; i--) {
+        if (es->ptrs[i].ptr == ts) {
+            es->ptrs[i] = es->ptrs[--es->nb_ptrs];
+        }
+    }
+}
+
+/* The memory at [OFS, OFS + SIZE) is written.  */
+static void env_clobber(EnvState *es, intptr_t ofs, int size)
+{
+    int i;
+
+    for (i = es->nb_values - 1; i >= 0; i--) {
+        if (env_ranges_overlap(ofs, size, es->values[i].ofs,
+                               es->values[i].size)) {
+            env_remove_value(es, i);
+        }
+    }
+}
+
+/* The memory at [OFS, OFS + SIZE) is read: the stores to it must stay.  */
+static void env_read(EnvState *es, intptr_t ofs, int size)
+{
+    int i;
+
+    for (i = es->nb_stores - 1; i >= 0; i--) {
+        if (env_ranges_overlap(ofs, size, es->stores[i].ofs,
+                               es->stores[i].size)) {
+            env_remove_store(es, i);
+        }
+    }
+}
+
+static void env_add_value(EnvState *es, intptr_t ofs, int size,
+                          TCGTemp *val, TCGOpcode ld_opc)
+{
+    EnvValue *v;
+
+    if (es->nb_values == ENV_MAX_VALUES) {
+        env_remove_value(es, 0);
+    }
+    v = &es->values[es->nb_values++];
+    v->ofs = ofs;
+    v->size = size;
+    v->val = val;
+    v->ld_opc = ld_opc;
+}
+
+static void env_add_store(EnvState *es, intptr_t ofs, int size, TCGOp *op)
+{
+    EnvStore *st;
+
+    if (es->nb_stores == ENV_MAX_VALUES) {
+        /* Forgetting a store only keeps it.  */
+        env_remove_store(es, 0);
+    }
+    st = &es->stores[es->nb_stores++];
+    st->ofs = ofs;
+    st->size = size;
+    st->op = op;
+}
+
+/* Return true if OP was replaced by a move, or removed.  */
+static bool env_optimize_op(TCGContext *s, EnvState *es, TCGOp *op,
+                            int nb_oargs, int nb_iargs)
+{
+    TCGOpcode opc = op->opc;
+    const TCGOpDef *def = &tcg_op_defs[opc];
+    TCGOpcode add_ptr = (TCG_TARGET_REG_BITS == 64
+                         ? INDEX_op_add_i64 : INDEX_op_add_i32);
+    TCGOpcode mov_ptr = (TCG_TARGET_REG_BITS == 64
+                         ? INDEX_op_mov_i64 : INDEX_op_mov_i32);
+    intptr_t base_ofs, ofs;
+    bool is_store;
+    int i, size;
+
+    if (def->flags & TCG_OPF_BB_END) {
+        env_reset(es);
+        return false;
+    }
+
+    switch (opc) {
+    case INDEX_op_call:
+        if (!(op->args[nb_oargs + nb_iargs + 1] & TCG_CALL_NO_SIDE_EFFECTS)) {
+            es->nb_values = 0;
+        } else if (!(op->args[nb_oargs + nb_iargs + 1]
+                     & TCG_CALL_NO_WRITE_GLOBALS)) {
+            for (i = es->nb_values - 1; i >= 0; i--) {
+                if (es->values[i].val->temp_global) {
+                    env_remove_value(es, i);
+                }
+            }
+        }
+        es->nb_stores = 0;
+        break;
+    case INDEX_op_qemu_ld_i32:
+    case INDEX_op_qemu_ld_i64:
+    case INDEX_op_qemu_st_i32:
+    case INDEX_op_qemu_st_i64:
+#ifdef CONFIG_SOFTMMU
+        /* An I/O access may run device code that changes the CPU.  */
+        es->nb_values = 0;
+#endif
+        es->nb_stores = 0;
+        break;
+    default:
+        break;
+    }
+
+    if ((opc == add_ptr && arg_is_const(op->args[2])) || opc == mov_ptr) {
+        /* Follow pointers into the CPU state, as made by
+           tcg_gen_addi_ptr(ptr, cpu_env, offset).  */
+        bool known = env_base(es, arg_temp(op->args[1]), &base_ofs);
+
+        env_forget_temp(es, arg_temp(op->args[0]));
+        if (known && es->nb_ptrs < ENV_MAX_PTRS) {
+            if (opc == add_ptr) {
+                base_ofs += (tcg_target_long)arg_info(op->args[2])->val;
+            }
+            es->ptrs[es->nb_ptrs].ptr = arg_temp(op->args[0]);
+            es->ptrs[es->nb_ptrs].ofs = base_ofs;
+            es->nb_ptrs++;
+        }
+        return false;
+    }
+
+    for (i = 0; i < nb_oargs; i++) {
+        env_forget_temp(es, arg_temp(op->args[i]));
+    }
+
+    size = env_op_size(opc, &is_store);
+    if (size == 0) {
+        return false;
+    }
+
+    if (!env_base(es, arg_temp(op->args[1]), &base_ofs)) {
+        /* This may access the CPU state at any offset.  */
+        if (is_store) {
+            es->nb_values = 0;
+        }
+        es->nb_stores = 0;
+        return false;
+    }
+    ofs = base_ofs + (intptr_t)op->args[2];
+    if (env_overlaps_global(s, es, ofs, size)) {
+        env_clobber(es, ofs, size);
+        env_read(es, ofs, size);
+        return false;
+    }
+
+    if (!is_store) {
+        TCGTemp *dst = arg_temp(op->args[0]);
+
+        for (i = 0; i < es->nb_values; i++) {
+            EnvValue *v = &es->values[i];
+
+            if (v->ofs == ofs && v->ld_opc == opc &&
+                v->val->type == dst->type) {
+                tcg_opt_gen_mov(s, op, op->args[0], temp_arg(v->val));
+                return true;
+            }
+        }
+        env_read(es, ofs, size);
+        env_add_value(es, ofs, size, dst, opc);
+        return false;
+    }
+
+    /* Remove the earlier stores that this one overwrites.  */
+    for (i = es->nb_stores - 1; i >= 0; i--) {
+        EnvStore *st = &es->stores[i];
+
+        if (st->ofs >= ofs && st->ofs + st->size <= ofs + size) {
+            tcg_op_remove(s, st->op);
+            env_remove_store(es, i);
+        }
+    }
+    env_clobber(es, ofs, size);
+    if (opc == INDEX_op_st_i32) {
+        env_add_value(es, ofs, size, arg_temp(op->args[0]), INDEX_op_ld_i32);
+    } else if (opc == INDEX_op_st_i64) {
+        env_add_value(es, ofs, size, arg_temp(op->args[0]), INDEX_op_ld_i64);
+    }
+    env_add_store(es, ofs, size, op);
+    return false;
+}
+
 /* Propagate constants and copies, fold constant expressions. */
 void tcg_optimize(TCGContext *s)
 {
@@ -606,6 +934,7 @@ void tcg_optimize(TCGContext *s)
     TCGOp *prev_mb = NULL;
     struct tcg_temp_info *infos;
     TCGTempSet temps_used;
+    EnvState *es;
 
     /* Array VALS has an element for each temp.
        If this temp holds a constant then its value is kept in VALS' element.
@@ -616,6 +945,9 @@ void tcg_optimize(TCGContext *s)
     nb_globals = s->nb_globals;
     bitmap_zero(temps_used.l, nb_temps);
     infos = tcg_malloc(sizeof(struct tcg_temp_info) * nb_temps);
+    es = tcg_malloc(sizeof(EnvState));
+    es->env = tcgv_ptr_temp(cpu_env);
+    env_reset(es);
 
     for (oi = s->gen_op_buf[0].next; oi != 0; oi = oi_next) {
         tcg_target_ulong mask, partmask, affected;
@@ -655,6 +987,11 @@ void tcg_optimize(TCGContext *s)
             }
         }
 
+        /* Forward and remove accesses to the CPU state.  */
+        if (env_optimize_op(s, es, op, nb_oargs, nb_iargs)) {
+            continue;
+        }
+
         /* For commutative operations make constant second argument */
         switch (opc) {
         CASE_OP_32_64(add):
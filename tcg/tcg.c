@@ -65,6 +65,9 @@
 static void tcg_target_init(TCGContext *s);
 static const TCGTargetOpDef *tcg_target_op_def(TCGOpcode);
 static void tcg_target_qemu_prologue(TCGContext *s);
+#if TCG_TARGET_HAS_tb_cache && defined(CONFIG_USER_ONLY)
+static void tcg_target_cache_host(TCGCacheHost *h);
+#endif
 static void patch_reloc(tcg_insn_unit *code_ptr, int type,
                         intptr_t value, intptr_t addend);
 
@@ -128,6 +131,10 @@ TCGv_env cpu_env = 0;
  * dynamically allocate from as demand dictates. Given appropriate region
  * sizing, this minimizes flushes even when some TCG threads generate a lot
  * more code than others.
+ *
+ * Once every region has been handed out, the region that filled up first
+ * can be evicted and reused instead of flushing the whole buffer; see
+ * tcg_region_victim().
  */
 struct tcg_region_state {
     QemuMutex lock;
@@ -143,6 +150,10 @@ struct tcg_region_state {
     /* fields protected by the lock */
     size_t current; /* current region index */
     size_t agg_size_full; /* aggregate size of full regions */
+    uint64_t fill_seq; /* number of regions filled up so far */
+    uint64_t *filled; /* per region: fill_seq when it filled up, or 0 */
+    size_t *evicted; /* evicted regions, ready to be handed out again */
+    size_t n_evicted;
 };
 
 static struct tcg_region_state region;
@@ -282,6 +293,37 @@ TCGLabel *gen_new_label(void)
     return l;
 }
 
+/* Record a 32-bit pc-relative field at FIELD that points to TARGET,
+ * when the code being generated is to be saved in the TB cache.
+ */
+static __attribute__((unused)) void tcg_cache_reloc(TCGContext *s,
+                                                    void *field, void *target)
+{
+    TCGCacheReloc *r;
+
+    if (!s->cache_record) {
+        return;
+    }
+    if (target >= (void *)s->code_buf && target < (void *)s->code_ptr) {
+        /* within the TB itself */
+        return;
+    }
+    if (s->nb_cache_relocs == TCG_MAX_CACHE_RELOCS) {
+        s->cache_unsafe = true;
+        return;
+    }
+    r = &s->cache_relocs[s->nb_cache_relocs++];
+    r->offset = tcg_ptr_byte_diff(field, s->code_buf);
+    /* The prologue is all there is in the buffer before the regions.  */
+    if (target >= s->code_gen_prologue && target < region.start) {
+        r->base = TCG_CACHE_RELOC_PROLOGUE;
+        r->addend = tcg_ptr_byte_diff(target, s->code_gen_prologue);
+    } else {
+        r->base = TCG_CACHE_RELOC_QEMU;
+        r->addend = (uintptr_t)target - (uintptr_t)tcg_gen_code;
+    }
+}
+
 #include "tcg-target.inc.c"
 
 static void tcg_region_bounds(size_t curr_region, void **pstart, void **pend)
@@ -314,13 +356,27 @@ static void tcg_region_assign(TCGContext *s, size_t curr_region)
     s->code_gen_highwater = end - TCG_HIGHWATER;
 }
 
+static size_t tcg_region_index(void *p)
+{
+    /* the first region may start before start_aligned */
+    if (p < region.start_aligned + region.stride) {
+        return 0;
+    }
+    return (p - region.start_aligned) / region.stride;
+}
+
 static bool tcg_region_alloc__locked(TCGContext *s)
 {
-    if (region.current == region.n) {
+    size_t curr_region;
+
+    if (region.n_evicted) {
+        curr_region = region.evicted[--region.n_evicted];
+    } else if (region.current < region.n) {
+        curr_region = region.current++;
+    } else {
         return true;
     }
-    tcg_region_assign(s, region.current);
-    region.current++;
+    tcg_region_assign(s, curr_region);
     return false;
 }
 
@@ -331,13 +387,15 @@ static bool tcg_region_alloc__locked(TCGContext *s)
 static bool tcg_region_alloc(TCGContext *s)
 {
     bool err;
-    /* read the region size now; alloc__locked will overwrite it on success */
+    /* read the region now; alloc__locked will overwrite it on success */
     size_t size_full = s->code_gen_buffer_size;
+    size_t full_region = tcg_region_index(s->code_gen_buffer);
 
     qemu_mutex_lock(&region.lock);
     err = tcg_region_alloc__locked(s);
     if (!err) {
         region.agg_size_full += size_full - TCG_HIGHWATER;
+        region.filled[full_region] = ++region.fill_seq;
     }
     qemu_mutex_unlock(&region.lock);
     return err;
@@ -361,6 +419,9 @@ void tcg_region_reset_all(void)
     qemu_mutex_lock(&region.lock);
     region.current = 0;
     region.agg_size_full = 0;
+    region.fill_seq = 0;
+    memset(region.filled, 0, region.n * sizeof(*region.filled));
+    region.n_evicted = 0;
 
     for (i = 0; i < n_ctxs; i++) {
         TCGContext *s = atomic_read(&tcg_ctxs[i]);
@@ -371,43 +432,90 @@ void tcg_region_reset_all(void)
     qemu_mutex_unlock(&region.lock);
 }
 
-#ifdef CONFIG_USER_ONLY
-static size_t tcg_n_regions(void)
+/*
+ * Find the region that filled up first among those that are not in use
+ * by any context, so that the TBs in it can be invalidated and the region
+ * reused.  Returns false if all regions are in use.
+ *
+ * Call from a safe-work context, and call tcg_region_release() once the
+ * TBs in [*pstart, *pend) are gone.
+ */
+bool tcg_region_victim(size_t *pidx, void **pstart, void **pend)
 {
-    return 1;
+    size_t victim = region.n;
+    size_t i;
+
+    qemu_mutex_lock(&region.lock);
+    for (i = 0; i < region.n; i++) {
+        if (region.filled[i] &&
+            (victim == region.n || region.filled[i] < region.filled[victim])) {
+            victim = i;
+        }
+    }
+    qemu_mutex_unlock(&region.lock);
+
+    if (victim == region.n) {
+        return false;
+    }
+    *pidx = victim;
+    tcg_region_bounds(victim, pstart, pend);
+    return true;
 }
-#else
+
+/* Call from a safe-work context */
+void tcg_region_release(size_t curr_region)
+{
+    void *start, *end;
+
+    tcg_region_bounds(curr_region, &start, &end);
+
+    qemu_mutex_lock(&region.lock);
+    g_assert(region.filled[curr_region]);
+    region.filled[curr_region] = 0;
+    region.agg_size_full -= end - start - TCG_HIGHWATER;
+    region.evicted[region.n_evicted++] = curr_region;
+    qemu_mutex_unlock(&region.lock);
+}
+
 /*
  * It is likely that some vCPUs will translate more code than others, so we
- * first try to set more regions than max_cpus, with those regions being of
- * reasonable size. If that's not possible we make do by evenly dividing
- * the code_gen_buffer among the vCPUs.
+ * first try to set more regions than TCG threads, with those regions being
+ * of reasonable size. If that's not possible we make do by evenly dividing
+ * the code_gen_buffer among the threads.
+ *
+ * With a single thread, the extra regions are what allows evicting part of
+ * the code cache rather than flushing all of it.
  */
 static size_t tcg_n_regions(void)
 {
+    size_t n_threads;
     size_t i;
 
-    /* Use a single region if all we have is one vCPU thread */
+#ifdef CONFIG_USER_ONLY
+    n_threads = 1;
+#else
     if (max_cpus == 1 || !qemu_tcg_mttcg_enabled()) {
-        return 1;
+        n_threads = 1;
+    } else {
+        n_threads = max_cpus;
     }
+#endif
 
-    /* Try to have more regions than max_cpus, with each region being >= 2 MB */
+    /* Try to have more regions than threads, with each region being >= 2 MB */
     for (i = 8; i > 0; i--) {
         size_t regions_per_thread = i;
         size_t region_size;
 
         region_size = tcg_init_ctx.code_gen_buffer_size;
-        region_size /= max_cpus * regions_per_thread;
+        region_size /= n_threads * regions_per_thread;
 
         if (region_size >= 2 * 1024u * 1024) {
-            return max_cpus * regions_per_thread;
+            return n_threads * regions_per_thread;
         }
     }
-    /* If we can't, then just allocate one region per vCPU thread */
-    return max_cpus;
+    /* If we can't, then just allocate one region per thread */
+    return n_threads;
 }
-#endif
 
 /*
  * Initializes region partitioning.
@@ -420,18 +528,18 @@ static size_t tcg_n_regions(void)
  * code in parallel without synchronization.
  *
  * In softmmu the number of TCG threads is bounded by max_cpus, so we use at
- * least max_cpus regions in MTTCG. In !MTTCG we use a single region.
+ * least max_cpus regions in MTTCG. In !MTTCG there is a single TCG thread.
  * Note that the TCG options from the command-line (i.e. -accel accel=tcg,[...])
  * must have been parsed before calling this function, since it calls
  * qemu_tcg_mttcg_enabled().
  *
- * In user-mode we use a single region.  Having multiple regions in user-mode
- * is not supported, because the number of vCPU threads (recall that each thread
- * spawned by the guest corresponds to a vCPU thread) is only bounded by the
- * OS, and usually this number is huge (tens of thousands is not uncommon).
- * Thus, given this large bound on the number of vCPU threads and the fact
- * that code_gen_buffer is allocated at compile-time, we cannot guarantee
- * that the availability of at least one region per vCPU thread.
+ * In user-mode all threads share a single context.  Having per-thread regions
+ * in user-mode is not supported, because the number of vCPU threads (recall
+ * that each thread spawned by the guest corresponds to a vCPU thread) is only
+ * bounded by the OS, and usually this number is huge (tens of thousands is not
+ * uncommon).  Thus, given this large bound on the number of vCPU threads and
+ * the fact that code_gen_buffer is allocated at compile-time, we cannot
+ * guarantee that the availability of at least one region per vCPU thread.
  *
  * However, this user-mode limitation is unlikely to be a significant problem
  * in practice. Multi-threaded guests share most if not all of their translated
@@ -474,6 +582,8 @@ void tcg_region_init(void)
     region.end = QEMU_ALIGN_PTR_DOWN(buf + size, page_size);
     /* account for that last guard page */
     region.end -= page_size;
+    region.filled = g_new0(uint64_t, n_regions);
+    region.evicted = g_new(size_t, n_regions);
 
     /* set guard pages */
     for (i = 0; i < region.n; i++) {
@@ -573,6 +683,53 @@ size_t tcg_code_size(void)
     return total;
 }
 
+#ifdef CONFIG_USER_ONLY
+/*
+ * Describe the host state that TB code generated by this process depends
+ * on, so that the TB cache only shares code between matching processes.
+ * Call after tcg_prologue_init.
+ */
+void tcg_cache_host(TCGCacheHost *h)
+{
+    memset(h, 0, sizeof(*h));
+#if TCG_TARGET_HAS_tb_cache
+    tcg_target_cache_host(h);
+#endif
+}
+#endif
+
+/*
+ * Apply the relocations of TB code that was generated by another process
+ * and copied to CODE.  Returns false if a target is out of reach.
+ */
+bool tcg_cache_relocate(void *code, const TCGCacheReloc *relocs, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        void *field = code + relocs[i].offset;
+        uintptr_t target;
+        intptr_t disp;
+
+        switch (relocs[i].base) {
+        case TCG_CACHE_RELOC_QEMU:
+            target = (uintptr_t)tcg_gen_code + relocs[i].addend;
+            break;
+        case TCG_CACHE_RELOC_PROLOGUE:
+            target = (uintptr_t)tcg_ctx->code_gen_prologue + relocs[i].addend;
+            break;
+        default:
+            return false;
+        }
+        disp = target - ((uintptr_t)field + 4);
+        if (disp != (int32_t)disp) {
+            return false;
+        }
+        stl_he_p(field, disp);
+    }
+    return true;
+}
+
 /*
  * Returns the code capacity (in bytes) of the entire cache, i.e. including all
  * regions.
@@ -862,6 +1019,10 @@ void tcg_func_start(TCGContext *s)
     s->goto_tb_issue_mask = 0;
 #endif
 
+    s->cache_record = false;
+    s->cache_unsafe = false;
+    s->nb_cache_relocs = 0;
+
     s->gen_op_buf[0].next = 1;
     s->gen_op_buf[0].prev = 0;
     s->gen_next_op_idx = 1;
@@ -149,6 +149,9 @@ typedef uint64_t TCGRegSet;
 #ifndef TCG_TARGET_extract_i64_valid
 #define TCG_TARGET_extract_i64_valid(ofs, len) 1
 #endif
+#ifndef TCG_TARGET_HAS_tb_cache
+#define TCG_TARGET_HAS_tb_cache 0
+#endif
 
 /* Only one of DIV or DIV2 should be defined.  */
 #if defined(TCG_TARGET_HAS_div_i32)
@@ -619,6 +622,30 @@ typedef struct TCGProfile {
     int64_t table_op_count[NB_OPS];
 } TCGProfile;
 
+/* A 32-bit pc-relative field of TB code that points outside of the TB,
+ * as saved by the persistent TB cache.  The field holds the distance from
+ * its own end to the target, which is ADDEND bytes from BASE.
+ */
+typedef struct TCGCacheReloc {
+    uint32_t offset; /* of the field from the start of the TB code */
+    uint32_t base;
+    int64_t addend;
+} TCGCacheReloc;
+
+/* The host state that TB code saved in the TB cache depends on.  */
+typedef struct TCGCacheHost {
+    uint32_t features;      /* optional host instructions in use */
+    uint32_t pad;
+    uint64_t guest_base;    /* if embedded in the code, else 0 */
+} TCGCacheHost;
+
+enum {
+    TCG_CACHE_RELOC_QEMU,     /* code or data of the QEMU executable */
+    TCG_CACHE_RELOC_PROLOGUE, /* the prologue and epilogue */
+};
+
+#define TCG_MAX_CACHE_RELOCS 256
+
 struct TCGContext {
     uint8_t *pool_cur, *pool_end;
     TCGPool *pool_first, *pool_current, *pool_first_large;
@@ -633,6 +660,14 @@ struct TCGContext {
     uintptr_t *tb_jmp_insn_offset; /* tb->jmp_target_arg if direct_jump */
     uintptr_t *tb_jmp_target_addr; /* tb->jmp_target_arg if !direct_jump */
 
+    /* TB cache support: set cache_record while generating code that may
+       be saved.  The backend then records its relocations, and avoids or
+       reports (cache_unsafe) code that depends on its own address.  */
+    bool cache_record;
+    bool cache_unsafe;
+    int nb_cache_relocs;
+    TCGCacheReloc cache_relocs[TCG_MAX_CACHE_RELOCS];
+
     TCGRegSet reserved_regs;
     uint32_t tb_cflags; /* cflags of the current TB */
     intptr_t current_frame_offset;
@@ -804,10 +839,17 @@ TranslationBlock *tcg_tb_alloc(TCGContext *s);
 
 void tcg_region_init(void);
 void tcg_region_reset_all(void);
+bool tcg_region_victim(size_t *pidx, void **pstart, void **pend);
+void tcg_region_release(size_t curr_region);
 
 size_t tcg_code_size(void);
 size_t tcg_code_capacity(void);
 
+bool tcg_cache_relocate(void *code, const TCGCacheReloc *relocs, int n);
+#ifdef CONFIG_USER_ONLY
+void tcg_cache_host(TCGCacheHost *h);
+#endif
+
 /* user-mode: Called with tb_lock held.  */
 static inline void *tcg_malloc(int size)
 {
@@ -0,0 +1,252 @@
+/*
+ * QTest testcase for the 68040/68060 MMU
+ *
+ * The guest code runs on the mcf5208evb board, whose RAM starts at
+ * 0x40000000 and whose UART0 is at 0xfc060000 (UART below), with
+ * -cpu m68040 or m68060.  It maps RAM and the UART with the transparent
+ * translation registers, and builds page tables for VIRT (0x10000000)
+ * at ROOT (0x40020000), PTR (0x40020200) and PAGES (0x40020400).
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "libqtest.h"
+
+/*
+ * Map VIRT to PHYS_A (0x40100000), then point the page entry at PHYS_B
+ * (0x40101000) and check that:
+ * - the ATC keeps the old translation until it is flushed;
+ * - PFLUSH with a user DFC does not flush the supervisor entry;
+ * - PFLUSH with the supervisor program DFC flushes the supervisor data
+ *   entry too.
+ * Then check that MOVEC accepts PCR on the 68060 only, and MSP on the
+ * 68040 only; VECTORS (0x40010000) sends the illegal instruction
+ * exceptions to "ill".  The test prints "MMU OK", or "MMU FAIL" and
+ * the character whose code is the number of the failed check.
+ */
+static const uint8_t kernel_mmu[] = {
+    0x4f, 0xf9, 0x40, 0x00, 0x80, 0x00,   /* _start: lea     0x40008000,%sp */
+    0x4b, 0xf9, 0xfc, 0x06, 0x00, 0x00,   /*         lea     UART,%a5 */
+    0x1b, 0x7c, 0x00, 0x04, 0x00, 0x08,   /*         move.b  #4,8(%a5) */
+    0x41, 0xf9, 0x40, 0x01, 0x00, 0x00,   /*         lea     VECTORS,%a0 */
+    0x43, 0xf9, 0x40, 0x00, 0x01, 0x6c,   /*         lea     unexp,%a1 */
+    0x20, 0x3c, 0x00, 0x00, 0x00, 0xff,   /*         move.l  #255,%d0 */
+    0x20, 0xc9,                           /* 1:      move.l  %a1,(%a0)+ */
+    0x51, 0xc8, 0xff, 0xfc,               /*         dbra    %d0,1b */
+    0x41, 0xf9, 0x40, 0x01, 0x00, 0x00,   /*         lea     VECTORS,%a0 */
+    0x43, 0xf9, 0x40, 0x00, 0x01, 0x64,   /*         lea     ill,%a1 */
+    0x21, 0x49, 0x00, 0x10,               /*         move.l  %a1,16(%a0) */
+    0x4e, 0x7b, 0x88, 0x01,               /*         movec   %a0,%vbr */
+    0x20, 0x3c, 0x40, 0x00, 0xc0, 0x00,   /*         move.l  #0x4000c000,%d0 */
+    0x4e, 0x7b, 0x00, 0x04,               /*         movec   %d0,%itt0 */
+    0x4e, 0x7b, 0x00, 0x06,               /*         movec   %d0,%dtt0 */
+    0x20, 0x3c, 0xfc, 0x00, 0xc0, 0x40,   /*         move.l  #0xfc00c040,%d0 */
+    0x4e, 0x7b, 0x00, 0x07,               /*         movec   %d0,%dtt1 */
+    0x41, 0xf9, 0x40, 0x02, 0x00, 0x00,   /*         lea     ROOT,%a0 */
+    0x21, 0x7c, 0x40, 0x02, 0x02, 0x02,   /*         move.l  #PTR+2,32(%a0) */
+    0x00, 0x20,
+    0x41, 0xf9, 0x40, 0x02, 0x02, 0x00,   /*         lea     PTR,%a0 */
+    0x20, 0xbc, 0x40, 0x02, 0x04, 0x02,   /*         move.l  #PAGES+2,(%a0) */
+    0x41, 0xf9, 0x40, 0x02, 0x04, 0x00,   /*         lea     PAGES,%a0 */
+    0x20, 0xbc, 0x40, 0x10, 0x00, 0x01,   /*         move.l  #PHYS_A+1,(%a0) */
+    0x23, 0xfc, 0x00, 0x00, 0x11, 0x11,   /*         move.l  #0x1111,PHYS_A */
+    0x40, 0x10, 0x00, 0x00,
+    0x23, 0xfc, 0x00, 0x00, 0x22, 0x22,   /*         move.l  #0x2222,PHYS_B */
+    0x40, 0x10, 0x10, 0x00,
+    0x20, 0x3c, 0x40, 0x02, 0x00, 0x00,   /*         move.l  #ROOT,%d0 */
+    0x4e, 0x7b, 0x08, 0x07,               /*         movec   %d0,%srp */
+    0x4e, 0x7b, 0x08, 0x06,               /*         movec   %d0,%urp */
+    0x20, 0x3c, 0x00, 0x00, 0x80, 0x00,   /*         move.l  #0x8000,%d0 */
+    0x4e, 0x7b, 0x00, 0x03,               /*         movec   %d0,%tc */
+    0x43, 0xf9, 0x10, 0x00, 0x00, 0x00,   /*         lea     VIRT,%a1 */
+    0x7e, 0x31,                           /*         moveq   #49,%d7 */
+    0x0c, 0x91, 0x00, 0x00, 0x11, 0x11,   /*         cmp.l   #0x1111,(%a1) */
+    0x66, 0x00, 0x00, 0x8e,               /*         bne     fail */
+    0x20, 0xbc, 0x40, 0x10, 0x10, 0x01,   /*         move.l  #PHYS_B+1,(%a0) */
+    0x7e, 0x32,                           /*         moveq   #50,%d7 */
+    0x0c, 0x91, 0x00, 0x00, 0x11, 0x11,   /*         cmp.l   #0x1111,(%a1) */
+    0x66, 0x00, 0x00, 0x7c,               /*         bne     fail */
+    0x70, 0x01,                           /*         moveq   #1,%d0 */
+    0x4e, 0x7b, 0x00, 0x01,               /*         movec   %d0,%dfc */
+    0xf5, 0x09,                           /*         pflush  (%a1) */
+    0x7e, 0x33,                           /*         moveq   #51,%d7 */
+    0x0c, 0x91, 0x00, 0x00, 0x11, 0x11,   /*         cmp.l   #0x1111,(%a1) */
+    0x66, 0x00, 0x00, 0x68,               /*         bne     fail */
+    0x70, 0x06,                           /*         moveq   #6,%d0 */
+    0x4e, 0x7b, 0x00, 0x01,               /*         movec   %d0,%dfc */
+    0xf5, 0x09,                           /*         pflush  (%a1) */
+    0x7e, 0x34,                           /*         moveq   #52,%d7 */
+    0x0c, 0x91, 0x00, 0x00, 0x22, 0x22,   /*         cmp.l   #0x2222,(%a1) */
+    0x66, 0x00, 0x00, 0x54,               /*         bne     fail */
+    0x7c, 0x00,                           /*         moveq   #0,%d6 */
+    0x20, 0x3c, 0xff, 0xff, 0xff, 0xff,   /*         move.l  #0xffffffff,%d0 */
+    0x4e, 0x7b, 0x08, 0x08,               /*         movec   %d0,%pcr */
+    0x4a, 0x86,                           /*         tst.l   %d6 */
+    0x66, 0x00, 0x00, 0x22,               /*         bne     no_pcr */
+    0x4e, 0x7a, 0x18, 0x08,               /*         movec   %pcr,%d1 */
+    0x7e, 0x35,                           /*         moveq   #53,%d7 */
+    0xb2, 0xbc, 0x04, 0x30, 0x01, 0x83,   /*         cmp.l   #0x04300183,%d1 */
+    0x66, 0x00, 0x00, 0x32,               /*         bne     fail */
+    0x4e, 0x7b, 0x08, 0x03,               /*         movec   %d0,%msp */
+    0x7e, 0x36,                           /*         moveq   #54,%d7 */
+    0x4a, 0x86,                           /*         tst.l   %d6 */
+    0x67, 0x00, 0x00, 0x26,               /*         beq     fail */
+    0x60, 0x00, 0x00, 0x18,               /*         bra     pass */
+    0x20, 0x3c, 0x12, 0x34, 0x56, 0x78,   /* no_pcr: move.l  #0x12345678,%d0 */
+    0x4e, 0x7b, 0x08, 0x03,               /*         movec   %d0,%msp */
+    0x4e, 0x7a, 0x18, 0x03,               /*         movec   %msp,%d1 */
+    0x7e, 0x37,                           /*         moveq   #55,%d7 */
+    0xb2, 0x80,                           /*         cmp.l   %d0,%d1 */
+    0x66, 0x00, 0x00, 0x0c,               /*         bne     fail */
+    0x41, 0xf9, 0x40, 0x00, 0x01, 0x72,   /* pass:   lea     ok,%a0 */
+    0x60, 0x00, 0x00, 0x0e,               /*         bra     print */
+    0x13, 0xc7, 0x40, 0x00, 0x01, 0x83,   /* fail:   move.b  %d7,code */
+    0x41, 0xf9, 0x40, 0x00, 0x01, 0x7a,   /*         lea     failed,%a0 */
+    0x10, 0x18,                           /* print:  move.b  (%a0)+,%d0 */
+    0x67, 0x00, 0x00, 0x0a,               /*         beq     done */
+    0x1b, 0x40, 0x00, 0x0c,               /*         move.b  %d0,12(%a5) */
+    0x60, 0x00, 0xff, 0xf4,               /*         bra     print */
+    0x60, 0x00, 0xff, 0xfe,               /* done:   bra     done */
+    0x7c, 0x01,                           /* ill:    moveq   #1,%d6 */
+    0x58, 0xaf, 0x00, 0x02,               /*         addq.l  #4,2(%sp) */
+    0x4e, 0x73,                           /*         rte */
+    0x7e, 0x58,                           /* unexp:  moveq   #88,%d7 */
+    0x60, 0x00, 0xff, 0xd6,               /*         bra     fail */
+    0x4d, 0x4d, 0x55, 0x20, 0x4f, 0x4b,   /* ok:     .ascii  "MMU OK\n\0" */
+    0x0a, 0x00,
+    0x4d, 0x4d, 0x55, 0x20, 0x46, 0x41,   /* failed: .ascii  "MMU FAIL " */
+    0x49, 0x4c, 0x20,
+    0x3f, 0x0a, 0x00,                     /* code:   .ascii  "?\n\0" */
+};
+
+/*
+ * Map NPAGES pages at VIRT to PHYS (0x40100000), then ITERATIONS times
+ * flush the ATC and read one word from each page, so that every read
+ * walks the page tables and refills the softmmu TLB.
+ */
+#define NPAGES      64
+#define ITERATIONS  20000
+
+static const uint8_t kernel_refill[] = {
+    0x4b, 0xf9, 0xfc, 0x06, 0x00, 0x00,   /* _start: lea     UART,%a5 */
+    0x1b, 0x7c, 0x00, 0x04, 0x00, 0x08,   /*         move.b  #4,8(%a5) */
+    0x20, 0x3c, 0x40, 0x00, 0xc0, 0x00,   /*         move.l  #0x4000c000,%d0 */
+    0x4e, 0x7b, 0x00, 0x04,               /*         movec   %d0,%itt0 */
+    0x4e, 0x7b, 0x00, 0x06,               /*         movec   %d0,%dtt0 */
+    0x20, 0x3c, 0xfc, 0x00, 0xc0, 0x40,   /*         move.l  #0xfc00c040,%d0 */
+    0x4e, 0x7b, 0x00, 0x07,               /*         movec   %d0,%dtt1 */
+    0x23, 0xfc, 0x40, 0x02, 0x02, 0x02,   /*         move.l  #PTR+2,ROOT+32 */
+    0x40, 0x02, 0x00, 0x20,
+    0x23, 0xfc, 0x40, 0x02, 0x04, 0x02,   /*         move.l  #PAGES+2,PTR */
+    0x40, 0x02, 0x02, 0x00,
+    0x41, 0xf9, 0x40, 0x02, 0x04, 0x00,   /*         lea     PAGES,%a0 */
+    0x20, 0x3c, 0x40, 0x10, 0x00, 0x01,   /*         move.l  #PHYS+1,%d0 */
+    0x22, 0x3c, 0x00, 0x00, 0x00, 0x3f,   /*         move.l  #NPAGES-1,%d1 */
+    0x20, 0xc0,                           /* 1:      move.l  %d0,(%a0)+ */
+    0xd0, 0xbc, 0x00, 0x00, 0x10, 0x00,   /*         add.l   #4096,%d0 */
+    0x51, 0xc9, 0xff, 0xf6,               /*         dbra    %d1,1b */
+    0x20, 0x3c, 0x40, 0x02, 0x00, 0x00,   /*         move.l  #ROOT,%d0 */
+    0x4e, 0x7b, 0x08, 0x07,               /*         movec   %d0,%srp */
+    0x4e, 0x7b, 0x08, 0x06,               /*         movec   %d0,%urp */
+    0x20, 0x3c, 0x00, 0x00, 0x80, 0x00,   /*         move.l  #0x8000,%d0 */
+    0x4e, 0x7b, 0x00, 0x03,               /*         movec   %d0,%tc */
+    0x24, 0x3c, 0x00, 0x00, 0x4e, 0x20,   /*         move.l  #ITERATIONS,%d2 */
+    0xf5, 0x18,                           /* 2:      pflusha */
+    0x41, 0xf9, 0x10, 0x00, 0x00, 0x00,   /*         lea     VIRT,%a0 */
+    0x22, 0x3c, 0x00, 0x00, 0x00, 0x3f,   /*         move.l  #NPAGES-1,%d1 */
+    0x4a, 0x90,                           /* 3:      tst.l   (%a0) */
+    0xd1, 0xfc, 0x00, 0x00, 0x10, 0x00,   /*         add.l   #4096,%a0 */
+    0x51, 0xc9, 0xff, 0xf6,               /*         dbra    %d1,3b */
+    0x53, 0x82,                           /*         subq.l  #1,%d2 */
+    0x66, 0x00, 0xff, 0xe2,               /*         bne     2b */
+    0x41, 0xf9, 0x40, 0x00, 0x00, 0xac,   /*         lea     msg,%a0 */
+    0x10, 0x18,                           /* 4:      move.b  (%a0)+,%d0 */
+    0x67, 0x00, 0x00, 0x0a,               /*         beq     5f */
+    0x1b, 0x40, 0x00, 0x0c,               /*         move.b  %d0,12(%a5) */
+    0x60, 0x00, 0xff, 0xf4,               /*         bra     4b */
+    0x60, 0x00, 0xff, 0xfe,               /* 5:      bra     5b */
+    0x52, 0x45, 0x46, 0x49, 0x4c, 0x4c,   /* msg:    .ascii  "REFILLED\n\0" */
+    0x45, 0x44, 0x0a, 0x00,
+};
+
+static char *write_kernel(const uint8_t *code, size_t size)
+{
+    char *name = g_strdup("/tmp/qtest-m68k-mmu-kernel-XXXXXX");
+    int fd;
+
+    fd = mkstemp(name);
+    g_assert(fd != -1);
+    g_assert(write(fd, code, size) == size);
+    close(fd);
+    return name;
+}
+
+/* Run CODE on CPU, and check that its first line of output is EXPECT.  */
+static void run_kernel(const char *cpu, const uint8_t *code, size_t size,
+                       const char *expect)
+{
+    char serialname[] = "/tmp/qtest-m68k-mmu-serial-XXXXXX";
+    char *kernel = write_kernel(code, size);
+    char line[64];
+    int fd, i, nbr, pos = 0;
+
+    fd = mkstemp(serialname);
+    g_assert(fd != -1);
+
+    global_qtest = qtest_startf("-M mcf5208evb,accel=tcg -cpu %s "
+                                "-kernel %s "
+                                "-chardev file,id=serial0,path=%s "
+                                "-serial chardev:serial0",
+                                cpu, kernel, serialname);
+    unlink(serialname);
+    unlink(kernel);
+    g_free(kernel);
+
+    /* Poll serial output... Wait at most 60 seconds */
+    for (i = 0; i < 6000 && pos < sizeof(line) - 1; ++i) {
+        while ((nbr = read(fd, &line[pos], 1)) == 1) {
+            if (line[pos++] == '\n' || pos == sizeof(line) - 1) {
+                goto done;
+            }
+        }
+        g_assert(nbr >= 0);
+        g_usleep(10000);
+    }
+
+done:
+    line[pos] = '\0';
+    g_assert_cmpstr(line, ==, expect);
+    qtest_quit(global_qtest);
+    close(fd);
+}
+
+static void test_mmu(const void *data)
+{
+    run_kernel(data, kernel_mmu, sizeof(kernel_mmu), "MMU OK\n");
+}
+
+static void test_refill(void)
+{
+    g_test_timer_start();
+    run_kernel("m68040", kernel_refill, sizeof(kernel_refill), "REFILLED\n");
+    g_test_timer_elapsed();
+
+    g_print("done: %d ATC refills in %.2f secs: ",
+            NPAGES * ITERATIONS, g_test_timer_last());
+    g_print("%.2f M/sec\n", NPAGES * ITERATIONS / g_test_timer_last() / 1e6);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    qtest_add_data_func("/mmu/m68040", "m68040", test_mmu);
+    qtest_add_data_func("/mmu/m68060", "m68060", test_mmu);
+    if (g_test_perf()) {
+        qtest_add_func("/mmu/refill", test_refill);
+    }
+
+    return g_test_run();
+}
@@ -0,0 +1,113 @@
+/*
+ * mmap/munmap churn, as done by memory allocators and language runtimes.
+ *
+ * Keeps a few thousand small anonymous mappings alive and keeps
+ * replacing random ones with mappings of another size, so that the
+ * guest address space is fragmented.  Every so often, one large mapping
+ * is written to /dev/null, which makes QEMU check that the whole buffer
+ * is readable.
+ *
+ * Usage: mmap-churn [ITERATIONS [MAPPINGS]]
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define MAX_PAGES   16
+#define LARGE_SIZE  (8 * 1024 * 1024)
+
+struct mapping {
+    char *addr;
+    size_t size;
+};
+
+static size_t pagesize;
+
+static void map(struct mapping *m)
+{
+    m->size = (1 + rand() % MAX_PAGES) * pagesize;
+    m->addr = mmap(NULL, m->size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (m->addr == MAP_FAILED) {
+        perror("mmap");
+        exit(EXIT_FAILURE);
+    }
+    m->addr[0] = 1;
+    m->addr[m->size - 1] = 1;
+}
+
+static void unmap(struct mapping *m)
+{
+    if (munmap(m->addr, m->size) < 0) {
+        perror("munmap");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long iterations = argc > 1 ? strtoul(argv[1], NULL, 0) : 200000;
+    unsigned long nr = argc > 2 ? strtoul(argv[2], NULL, 0) : 4096;
+    struct mapping *maps;
+    char *large;
+    double start;
+    unsigned long i;
+    int fd;
+
+    pagesize = getpagesize();
+    maps = calloc(nr, sizeof(*maps));
+    fd = open("/dev/null", O_WRONLY);
+    if (!nr || !maps || fd < 0) {
+        fprintf(stderr, "Usage: %s [ITERATIONS [MAPPINGS]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    srand(1);
+    start = now();
+    for (i = 0; i < nr; i++) {
+        map(&maps[i]);
+    }
+
+    for (i = 0; i < iterations; i++) {
+        struct mapping *m = &maps[rand() % nr];
+
+        unmap(m);
+        map(m);
+
+        if (i % 256 == 0) {
+            large = mmap(NULL, LARGE_SIZE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (large == MAP_FAILED) {
+                perror("mmap");
+                return EXIT_FAILURE;
+            }
+            if (write(fd, large, LARGE_SIZE) != LARGE_SIZE) {
+                perror("write");
+                return EXIT_FAILURE;
+            }
+            munmap(large, LARGE_SIZE);
+        }
+    }
+
+    for (i = 0; i < nr; i++) {
+        unmap(&maps[i]);
+    }
+    printf("%lu mappings, %lu iterations: %.3f s\n",
+           nr, iterations, now() - start);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,407 @@
+/*
+ * Test the host fast path of the m68k FPU helpers
+ *
+ * The arithmetic operations must give the same bits and the same
+ * inexact flag as softfloat.  The transcendental functions are checked
+ * against another evaluation by the host libm: in long double for single
+ * precision, which must give the same correctly rounded result, and in
+ * double for double precision, which must be within the libm error.  The FPSP code in softfloat is not as accurate, for
+ * example for sin and cos near a large multiple of pi, so differences
+ * with it are only reported.  With -m perf, the fast path is also timed
+ * against softfloat.
+ *
+ * This work is licensed under the terms of the GNU LGPL, version 2 or later.
+ * See the COPYING.LIB file in the top-level directory.
+ *
+ */
+
+#include "qemu/osdep.h"
+#include "fpu/softfloat.h"
+#include "target/m68k/fpu_host.h"
+
+#define ITERATIONS 200000
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t rand64(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/* The significand bits of floatx80 rounded to PREC.  */
+static int prec_bits(int prec)
+{
+    return prec == 32 ? 24 : prec == 64 ? 53 : 64;
+}
+
+static void init_status(float_status *status, int prec)
+{
+    memset(status, 0, sizeof(*status));
+    set_float_rounding_mode(float_round_nearest_even, status);
+    set_floatx80_rounding_precision(prec, status);
+}
+
+/* A random operand with BITS significant bits and an exponent around
+   EXP.  Small integers exercise the exact results.  */
+static floatx80 rand_operand(int bits, int exp, int spread)
+{
+    uint64_t x = rand64();
+    uint64_t low;
+    float_status status;
+
+    if ((x & 7) == 0) {
+        init_status(&status, 80);
+        return int32_to_floatx80((int32_t)(x >> 32) % 1000, &status);
+    }
+    low = (1ULL << 63) | (rand64() >> 1);
+    if (bits < 64) {
+        low &= -1ULL << (64 - bits);
+    }
+    exp += (int)((x >> 8) % (2 * spread + 1)) - spread;
+    return make_floatx80(((x >> 4) & 1) << 15 | (0x3fff + exp), low);
+}
+
+static floatx80 softfloat_op(FPUOp op, floatx80 a, floatx80 b,
+                             float_status *status)
+{
+    switch (op) {
+    case FPU_OP_ADD:
+        return floatx80_add(a, b, status);
+    case FPU_OP_SUB:
+        return floatx80_sub(a, b, status);
+    case FPU_OP_MUL:
+        return floatx80_mul(a, b, status);
+    case FPU_OP_DIV:
+        return floatx80_div(a, b, status);
+    case FPU_OP_SQRT:
+        return floatx80_sqrt(a, status);
+    default:
+        g_assert_not_reached();
+    }
+}
+
+static floatx80 softfloat_func(FPUFunc func, floatx80 a,
+                               float_status *status)
+{
+    switch (func) {
+    case FPU_FUNC_SIN:
+        return floatx80_sin(a, status);
+    case FPU_FUNC_COS:
+        return floatx80_cos(a, status);
+    case FPU_FUNC_TAN:
+        return floatx80_tan(a, status);
+    case FPU_FUNC_ASIN:
+        return floatx80_asin(a, status);
+    case FPU_FUNC_ACOS:
+        return floatx80_acos(a, status);
+    case FPU_FUNC_ATAN:
+        return floatx80_atan(a, status);
+    case FPU_FUNC_SINH:
+        return floatx80_sinh(a, status);
+    case FPU_FUNC_COSH:
+        return floatx80_cosh(a, status);
+    case FPU_FUNC_TANH:
+        return floatx80_tanh(a, status);
+    case FPU_FUNC_ATANH:
+        return floatx80_atanh(a, status);
+    case FPU_FUNC_ETOX:
+        return floatx80_etox(a, status);
+    case FPU_FUNC_TWOTOX:
+        return floatx80_twotox(a, status);
+    case FPU_FUNC_TENTOX:
+        return floatx80_tentox(a, status);
+    case FPU_FUNC_LOGN:
+        return floatx80_logn(a, status);
+    case FPU_FUNC_LOGNP1:
+        return floatx80_lognp1(a, status);
+    case FPU_FUNC_LOG10:
+        return floatx80_log10(a, status);
+    case FPU_FUNC_LOG2:
+        return floatx80_log2(a, status);
+    default:
+        g_assert_not_reached();
+    }
+}
+
+static bool fast_op(int prec, FPUOp op, floatx80 a, floatx80 b,
+                    floatx80 *res, bool *inexact)
+{
+    return prec == 64 ? fpu_fast_op_f64(op, a, b, res, inexact)
+                      : fpu_fast_op_f32(op, a, b, res, inexact);
+}
+
+static bool fast_func(int prec, FPUFunc func, floatx80 a, floatx80 *res)
+{
+    return prec == 64 ? fpu_fast_func_f64(func, a, res)
+                      : fpu_fast_func_f32(func, a, res);
+}
+
+static void test_op(gconstpointer data)
+{
+    int prec = GPOINTER_TO_INT(data);
+    float_status status;
+    unsigned taken = 0, inexact_count = 0;
+    int i;
+
+    init_status(&status, prec);
+    for (i = 0; i < ITERATIONS; i++) {
+        FPUOp op = rand64() % (FPU_OP_SQRT + 1);
+        /* Mostly close exponents, for cancellations and exact results,
+           sometimes far ones, for the range checks.  */
+        int spread = (i & 15) ? 4 : 1100;
+        floatx80 a = rand_operand(prec_bits(prec), 0, spread);
+        floatx80 b = rand_operand(prec_bits(prec), 0, spread);
+        floatx80 r, check;
+        bool inexact;
+
+        if (!fast_op(prec, op, a, b, &r, &inexact)) {
+            continue;
+        }
+        taken++;
+        inexact_count += inexact;
+        set_float_exception_flags(0, &status);
+        check = softfloat_op(op, a, b, &status);
+        g_assert_cmphex(r.high, ==, check.high);
+        g_assert_cmphex(r.low, ==, check.low);
+        g_assert_cmphex(get_float_exception_flags(&status), ==,
+                        inexact ? float_flag_inexact : 0);
+    }
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+    g_assert_cmpuint(inexact_count, >, 0);
+    g_assert_cmpuint(taken - inexact_count, >, 0);
+#endif
+}
+
+/* The distance in units of the last place between two floatx80 values
+   of the same sign rounded to PREC.  */
+static uint64_t ulp_distance(int prec, floatx80 a, floatx80 b)
+{
+    int bits = prec_bits(prec);
+    uint64_t ia = ((uint64_t)(a.high & 0x7fff) << (bits - 1)) |
+                  (a.low & ~(1ULL << 63)) >> (64 - bits);
+    uint64_t ib = ((uint64_t)(b.high & 0x7fff) << (bits - 1)) |
+                  (b.low & ~(1ULL << 63)) >> (64 - bits);
+
+    g_assert_cmphex(a.high & 0x8000, ==, b.high & 0x8000);
+    return ia > ib ? ia - ib : ib - ia;
+}
+
+/* A random argument in the domain of FUNC, which fits in a double.  */
+static floatx80 rand_argument(FPUFunc func)
+{
+    floatx80 a = rand_operand(53, -2, 5);
+
+    switch (func) {
+    case FPU_FUNC_ASIN:
+    case FPU_FUNC_ACOS:
+    case FPU_FUNC_ATANH:
+        if ((a.high & 0x7fff) >= 0x3fff) {
+            a.high -= (a.high & 0x7fff) - 0x3ffe;
+        }
+        break;
+    case FPU_FUNC_LOGN:
+    case FPU_FUNC_LOG10:
+    case FPU_FUNC_LOG2:
+    case FPU_FUNC_LOGNP1:
+        a.high &= 0x7fff;
+        break;
+    default:
+        break;
+    }
+    return a;
+}
+
+/* FUNC(A) rounded to PREC by another path than the fast one, and how far
+   from the correctly rounded result it may be.  */
+static floatx80 reference_func(int prec, FPUFunc func, floatx80 a,
+                               uint64_t *tolerance)
+{
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+    double da;
+
+    g_assert_true(floatx80_to_host_double(a, &da));
+    if (prec == 32) {
+#if LDBL_MANT_DIG >= 64
+        *tolerance = 0;
+        return host_float_to_floatx80(fpu_host_funcl(func, da));
+#else
+        *tolerance = 1;
+        return host_float_to_floatx80(fpu_host_func(func, da));
+#endif
+    }
+    /* glibc documents errors of up to 2 ulp in double precision for
+       some of the functions, tanh for example.  */
+    *tolerance = 2;
+    return host_double_to_floatx80(fpu_host_func(func, da));
+#else
+    g_assert_not_reached();
+#endif
+}
+
+static void test_func(gconstpointer data)
+{
+    int prec = GPOINTER_TO_INT(data);
+    float_status status;
+    unsigned taken = 0, differences = 0;
+    uint64_t max_distance = 0;
+    int i;
+
+    init_status(&status, prec);
+    for (i = 0; i < ITERATIONS; i++) {
+        FPUFunc func = rand64() % (FPU_FUNC_LOG2 + 1);
+        floatx80 a = rand_argument(func);
+        floatx80 r, check;
+        uint64_t distance, tolerance;
+
+        if (!fast_func(prec, func, a, &r)) {
+            continue;
+        }
+        taken++;
+        check = reference_func(prec, func, a, &tolerance);
+        if (ulp_distance(prec, r, check) > tolerance) {
+            g_test_message("func %d a %04x %016" PRIx64 " host %04x %016"
+                           PRIx64 " reference %04x %016" PRIx64, func,
+                           a.high, a.low, r.high, r.low,
+                           check.high, check.low);
+        }
+        g_assert_cmpuint(ulp_distance(prec, r, check), <=, tolerance);
+
+        check = softfloat_func(func, a, &status);
+        distance = ulp_distance(prec, r, check);
+        if (distance) {
+            differences++;
+            max_distance = MAX(max_distance, distance);
+        }
+    }
+    g_test_message("%u of %u results differ from the FPSP code, by up to %"
+                   PRIu64 " ulp", differences, taken, max_distance);
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+    if (prec == 32 || LDBL_MANT_DIG >= 64) {
+        g_assert_cmpuint(taken, >, ITERATIONS / 2);
+    }
+#endif
+}
+
+/* Results that can be exact go through the FPSP code, which knows.  */
+static void test_func_exact(void)
+{
+    float_status status;
+    floatx80 r;
+    int prec;
+
+    init_status(&status, 80);
+    for (prec = 32; prec <= 64; prec += 32) {
+        g_assert_false(fast_func(prec, FPU_FUNC_TWOTOX,
+                                 int32_to_floatx80(3, &status), &r));
+        g_assert_false(fast_func(prec, FPU_FUNC_TENTOX,
+                                 int32_to_floatx80(2, &status), &r));
+        g_assert_false(fast_func(prec, FPU_FUNC_LOG2,
+                                 int32_to_floatx80(8, &status), &r));
+        g_assert_false(fast_func(prec, FPU_FUNC_LOG10,
+                                 int32_to_floatx80(1000, &status), &r));
+    }
+}
+
+static void test_op_perf(gconstpointer data)
+{
+    int prec = GPOINTER_TO_INT(data);
+    static floatx80 args[1024];
+    float_status status;
+    floatx80 r;
+    bool inexact;
+    uint64_t sink = 0;
+    double host, soft;
+    FPUOp op;
+    int i;
+
+    init_status(&status, prec);
+    for (i = 0; i < ARRAY_SIZE(args); i++) {
+        args[i] = rand_operand(prec_bits(prec), 0, 4);
+    }
+    for (op = FPU_OP_ADD; op <= FPU_OP_SQRT; op++) {
+        g_test_timer_start();
+        for (i = 0; i < ITERATIONS; i++) {
+            floatx80 a = args[i & 1023], b = args[(i + 1) & 1023];
+
+            if (!fast_op(prec, op, a, b, &r, &inexact)) {
+                r = softfloat_op(op, a, b, &status);
+            }
+            sink += r.low;
+        }
+        host = g_test_timer_elapsed();
+        g_test_timer_start();
+        for (i = 0; i < ITERATIONS; i++) {
+            r = softfloat_op(op, args[i & 1023], args[(i + 1) & 1023],
+                             &status);
+            sink += r.low;
+        }
+        soft = g_test_timer_elapsed();
+        g_print("op %d: host %.1f ns, softfloat %.1f ns\n", op,
+                host * 1e9 / ITERATIONS, soft * 1e9 / ITERATIONS);
+    }
+    g_assert(sink != 1);
+}
+
+static void test_func_perf(gconstpointer data)
+{
+    int prec = GPOINTER_TO_INT(data);
+    static floatx80 args[1024];
+    float_status status;
+    floatx80 r;
+    uint64_t sink = 0;
+    double host, soft;
+    FPUFunc func;
+    int i;
+
+    init_status(&status, prec);
+    for (func = FPU_FUNC_SIN; func <= FPU_FUNC_LOG2; func++) {
+        for (i = 0; i < ARRAY_SIZE(args); i++) {
+            args[i] = rand_argument(func);
+        }
+        g_test_timer_start();
+        for (i = 0; i < ITERATIONS / 10; i++) {
+            if (!fast_func(prec, func, args[i & 1023], &r)) {
+                r = softfloat_func(func, args[i & 1023], &status);
+            }
+            sink += r.low;
+        }
+        host = g_test_timer_elapsed();
+        g_test_timer_start();
+        for (i = 0; i < ITERATIONS / 10; i++) {
+            r = softfloat_func(func, args[i & 1023], &status);
+            sink += r.low;
+        }
+        soft = g_test_timer_elapsed();
+        g_print("func %d: host %.1f ns, FPSP %.1f ns\n", func,
+                host * 1e10 / ITERATIONS, soft * 1e10 / ITERATIONS);
+    }
+    g_assert(sink != 1);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_data_func("/m68k-fpu-host/op/single", GINT_TO_POINTER(32),
+                         test_op);
+    g_test_add_data_func("/m68k-fpu-host/op/double", GINT_TO_POINTER(64),
+                         test_op);
+    g_test_add_data_func("/m68k-fpu-host/func/single", GINT_TO_POINTER(32),
+                         test_func);
+    g_test_add_data_func("/m68k-fpu-host/func/double", GINT_TO_POINTER(64),
+                         test_func);
+    g_test_add_func("/m68k-fpu-host/func/exact", test_func_exact);
+    if (g_test_perf()) {
+        g_test_add_data_func("/m68k-fpu-host/perf/op/single",
+                             GINT_TO_POINTER(32), test_op_perf);
+        g_test_add_data_func("/m68k-fpu-host/perf/op/double",
+                             GINT_TO_POINTER(64), test_op_perf);
+        g_test_add_data_func("/m68k-fpu-host/perf/func/single",
+                             GINT_TO_POINTER(32), test_func_perf);
+        g_test_add_data_func("/m68k-fpu-host/perf/func/double",
+                             GINT_TO_POINTER(64), test_func_perf);
+    }
+    return g_test_run();
+}
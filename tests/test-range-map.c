@@ -0,0 +1,119 @@
+/*
+ * RangeMap unit tests.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+#include "qemu/osdep.h"
+#include "qemu/range-map.h"
+
+#define N 1024
+
+static void check_run(RangeMap *map, uint64_t point, unsigned value,
+                      uint64_t start, uint64_t end)
+{
+    uint64_t s, e;
+
+    g_assert_cmpuint(range_map_get(map, point, &s, &e), ==, value);
+    g_assert_cmpuint(s, ==, start);
+    g_assert_cmpuint(e, ==, end);
+}
+
+static void test_set(void)
+{
+    RangeMap *map = range_map_new(N);
+
+    check_run(map, 0, 0, 0, N);
+    range_map_set(map, 100, 200, 1);
+    check_run(map, 99, 0, 0, 100);
+    check_run(map, 150, 1, 100, 200);
+    check_run(map, 200, 0, 200, N);
+
+    /* Split a run, then merge it back.  */
+    range_map_set(map, 120, 130, 2);
+    check_run(map, 110, 1, 100, 120);
+    check_run(map, 125, 2, 120, 130);
+    check_run(map, 130, 1, 130, 200);
+    range_map_set(map, 120, 130, 1);
+    check_run(map, 125, 1, 100, 200);
+
+    /* Cover several runs at once.  */
+    range_map_set(map, 300, 400, 1);
+    range_map_set(map, 150, 350, 3);
+    check_run(map, 100, 1, 100, 150);
+    check_run(map, 250, 3, 150, 350);
+    check_run(map, 399, 1, 350, 400);
+
+    range_map_set(map, 0, N, 0);
+    check_run(map, N - 1, 0, 0, N);
+    range_map_destroy(map);
+}
+
+static void test_find_free(void)
+{
+    RangeMap *map = range_map_new(N);
+    uint64_t start;
+
+    g_assert(range_map_find_free_last(map, N, 16, 1, &start));
+    g_assert_cmpuint(start, ==, N - 16);
+
+    range_map_set(map, 512, N, 1);
+    range_map_set(map, 100, 500, 1);
+    /* The hole [500, 512) is the highest, but only fits 12.  */
+    g_assert(range_map_find_free_last(map, N, 12, 1, &start));
+    g_assert_cmpuint(start, ==, 500);
+    g_assert(range_map_find_free_last(map, N, 12, 8, &start));
+    g_assert_cmpuint(start, ==, 88);
+    g_assert(range_map_find_free_last(map, N, 13, 1, &start));
+    g_assert_cmpuint(start, ==, 87);
+    g_assert(range_map_find_free_last(map, 50, 13, 1, &start));
+    g_assert_cmpuint(start, ==, 37);
+    g_assert(!range_map_find_free_last(map, N, 101, 1, &start));
+    range_map_destroy(map);
+}
+
+/* Compare with a flat array after random updates.  */
+static void test_random(void)
+{
+    RangeMap *map = range_map_new(N);
+    unsigned ref[N] = { 0 };
+    int i;
+
+    for (i = 0; i < 10000; i++) {
+        uint64_t a = g_test_rand_int_range(0, N + 1);
+        uint64_t b = g_test_rand_int_range(0, N + 1);
+        unsigned value = g_test_rand_int_range(0, 3);
+        uint64_t point = g_test_rand_int_range(0, N);
+        uint64_t s, e, j;
+
+        if (a > b) {
+            uint64_t t = a;
+
+            a = b;
+            b = t;
+        }
+        range_map_set(map, a, b, value);
+        for (j = a; j < b; j++) {
+            ref[j] = value;
+        }
+
+        value = range_map_get(map, point, &s, &e);
+        g_assert_cmpuint(value, ==, ref[point]);
+        for (j = s; j < e; j++) {
+            g_assert_cmpuint(ref[j], ==, value);
+        }
+        /* Runs are as long as possible.  */
+        g_assert(s == 0 || ref[s - 1] != value);
+        g_assert(e == N || ref[e] != value);
+    }
+    range_map_destroy(map);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/range-map/set", test_set);
+    g_test_add_func("/range-map/find-free", test_find_free);
+    g_test_add_func("/range-map/random", test_random);
+    return g_test_run();
+}
@@ -0,0 +1,289 @@
+/*
+ * Test the 128-bit helpers of softfloat-macros.h
+ *
+ * Hosts with CONFIG_INT128 implement them with native 128-bit integers;
+ * check that this gives the same bits as the portable 64-bit code, which
+ * is reproduced here as the reference.
+ *
+ * This work is licensed under the terms of the GNU LGPL, version 2 or later.
+ * See the COPYING.LIB file in the top-level directory.
+ *
+ */
+
+#include "qemu/osdep.h"
+#include "fpu/softfloat.h"
+#include "fpu/softfloat-macros.h"
+
+#define ITERATIONS 200000
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+/* Random operands biased towards the edge cases of the carry logic.  */
+static uint64_t rand64(void)
+{
+    uint64_t x;
+
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    x = rng_state;
+    switch (x & 7) {
+    case 0:
+        return 0;
+    case 1:
+        return -1ULL;
+    case 2:
+        return x >> (x >> 58);
+    case 3:
+        return -1ULL << ((x >> 8) & 63);
+    default:
+        return x;
+    }
+}
+
+static void ref_shift128Right(uint64_t a0, uint64_t a1, int count,
+                              uint64_t *z0Ptr, uint64_t *z1Ptr)
+{
+    uint64_t z0, z1;
+    int8_t negCount = (-count) & 63;
+
+    if (count == 0) {
+        z1 = a1;
+        z0 = a0;
+    } else if (count < 64) {
+        z1 = (a0 << negCount) | (a1 >> count);
+        z0 = a0 >> count;
+    } else {
+        z1 = (count < 128) ? (a0 >> (count & 63)) : 0;
+        z0 = 0;
+    }
+    *z1Ptr = z1;
+    *z0Ptr = z0;
+}
+
+static void ref_shift128RightJamming(uint64_t a0, uint64_t a1, int count,
+                                     uint64_t *z0Ptr, uint64_t *z1Ptr)
+{
+    uint64_t z0, z1;
+    int8_t negCount = (-count) & 63;
+
+    if (count == 0) {
+        z1 = a1;
+        z0 = a0;
+    } else if (count < 64) {
+        z1 = (a0 << negCount) | (a1 >> count) | ((a1 << negCount) != 0);
+        z0 = a0 >> count;
+    } else {
+        if (count == 64) {
+            z1 = a0 | (a1 != 0);
+        } else if (count < 128) {
+            z1 = (a0 >> (count & 63)) | (((a0 << negCount) | a1) != 0);
+        } else {
+            z1 = ((a0 | a1) != 0);
+        }
+        z0 = 0;
+    }
+    *z1Ptr = z1;
+    *z0Ptr = z0;
+}
+
+static void ref_shortShift128Left(uint64_t a0, uint64_t a1, int count,
+                                  uint64_t *z0Ptr, uint64_t *z1Ptr)
+{
+    *z1Ptr = a1 << count;
+    *z0Ptr = (count == 0) ? a0 : (a0 << count) | (a1 >> ((-count) & 63));
+}
+
+static void ref_add128(uint64_t a0, uint64_t a1, uint64_t b0, uint64_t b1,
+                       uint64_t *z0Ptr, uint64_t *z1Ptr)
+{
+    uint64_t z1;
+
+    z1 = a1 + b1;
+    *z1Ptr = z1;
+    *z0Ptr = a0 + b0 + (z1 < a1);
+}
+
+static void ref_sub128(uint64_t a0, uint64_t a1, uint64_t b0, uint64_t b1,
+                       uint64_t *z0Ptr, uint64_t *z1Ptr)
+{
+    *z1Ptr = a1 - b1;
+    *z0Ptr = a0 - b0 - (a1 < b1);
+}
+
+static void ref_mul64To128(uint64_t a, uint64_t b,
+                           uint64_t *z0Ptr, uint64_t *z1Ptr)
+{
+    uint32_t aHigh, aLow, bHigh, bLow;
+    uint64_t z0, zMiddleA, zMiddleB, z1;
+
+    aLow = a;
+    aHigh = a >> 32;
+    bLow = b;
+    bHigh = b >> 32;
+    z1 = ((uint64_t) aLow) * bLow;
+    zMiddleA = ((uint64_t) aLow) * bHigh;
+    zMiddleB = ((uint64_t) aHigh) * bLow;
+    z0 = ((uint64_t) aHigh) * bHigh;
+    zMiddleA += zMiddleB;
+    z0 += (((uint64_t) (zMiddleA < zMiddleB)) << 32) + (zMiddleA >> 32);
+    zMiddleA <<= 32;
+    z1 += zMiddleA;
+    z0 += (z1 < zMiddleA);
+    *z1Ptr = z1;
+    *z0Ptr = z0;
+}
+
+static void ref_mul128By64To192(uint64_t a0, uint64_t a1, uint64_t b,
+                                uint64_t *z0Ptr, uint64_t *z1Ptr,
+                                uint64_t *z2Ptr)
+{
+    uint64_t z0, z1, z2, more1;
+
+    ref_mul64To128(a1, b, &z1, &z2);
+    ref_mul64To128(a0, b, &z0, &more1);
+    ref_add128(z0, more1, 0, z1, &z0, &z1);
+    *z2Ptr = z2;
+    *z1Ptr = z1;
+    *z0Ptr = z0;
+}
+
+static uint64_t ref_estimateDiv128To64(uint64_t a0, uint64_t a1, uint64_t b)
+{
+    uint64_t b0, b1;
+    uint64_t rem0, rem1, term0, term1;
+    uint64_t z;
+
+    if (b <= a0) {
+        return 0xFFFFFFFFFFFFFFFFULL;
+    }
+    b0 = b >> 32;
+    z = (b0 << 32 <= a0) ? 0xFFFFFFFF00000000ULL : (a0 / b0) << 32;
+    ref_mul64To128(b, z, &term0, &term1);
+    ref_sub128(a0, a1, term0, term1, &rem0, &rem1);
+    while (((int64_t) rem0) < 0) {
+        z -= 0x100000000ULL;
+        b1 = b << 32;
+        ref_add128(rem0, rem1, b0, b1, &rem0, &rem1);
+    }
+    rem0 = (rem0 << 32) | (rem1 >> 32);
+    z |= (b0 << 32 <= rem0) ? 0xFFFFFFFF : rem0 / b0;
+    return z;
+}
+
+static void test_shifts(void)
+{
+    int i;
+
+    for (i = 0; i < ITERATIONS; i++) {
+        uint64_t a0 = rand64(), a1 = rand64();
+        int count = rand64() % 140;
+        uint64_t z0, z1, r0, r1;
+
+        shift128Right(a0, a1, count, &z0, &z1);
+        ref_shift128Right(a0, a1, count, &r0, &r1);
+        g_assert_cmphex(z0, ==, r0);
+        g_assert_cmphex(z1, ==, r1);
+
+        shift128RightJamming(a0, a1, count, &z0, &z1);
+        ref_shift128RightJamming(a0, a1, count, &r0, &r1);
+        g_assert_cmphex(z0, ==, r0);
+        g_assert_cmphex(z1, ==, r1);
+
+        count &= 63;
+        shortShift128Left(a0, a1, count, &z0, &z1);
+        ref_shortShift128Left(a0, a1, count, &r0, &r1);
+        g_assert_cmphex(z0, ==, r0);
+        g_assert_cmphex(z1, ==, r1);
+    }
+}
+
+static void test_add_sub(void)
+{
+    int i;
+
+    for (i = 0; i < ITERATIONS; i++) {
+        uint64_t a0 = rand64(), a1 = rand64(), b0 = rand64(), b1 = rand64();
+        uint64_t z0, z1, r0, r1;
+
+        add128(a0, a1, b0, b1, &z0, &z1);
+        ref_add128(a0, a1, b0, b1, &r0, &r1);
+        g_assert_cmphex(z0, ==, r0);
+        g_assert_cmphex(z1, ==, r1);
+
+        sub128(a0, a1, b0, b1, &z0, &z1);
+        ref_sub128(a0, a1, b0, b1, &r0, &r1);
+        g_assert_cmphex(z0, ==, r0);
+        g_assert_cmphex(z1, ==, r1);
+    }
+}
+
+static void test_mul(void)
+{
+    int i;
+
+    for (i = 0; i < ITERATIONS; i++) {
+        uint64_t a0 = rand64(), a1 = rand64(), b = rand64();
+        uint64_t z0, z1, z2, r0, r1, r2;
+
+        mul64To128(a1, b, &z0, &z1);
+        ref_mul64To128(a1, b, &r0, &r1);
+        g_assert_cmphex(z0, ==, r0);
+        g_assert_cmphex(z1, ==, r1);
+
+        mul128By64To192(a0, a1, b, &z0, &z1, &z2);
+        ref_mul128By64To192(a0, a1, b, &r0, &r1, &r2);
+        g_assert_cmphex(z0, ==, r0);
+        g_assert_cmphex(z1, ==, r1);
+        g_assert_cmphex(z2, ==, r2);
+    }
+}
+
+static void test_div(void)
+{
+    int i;
+
+    for (i = 0; i < ITERATIONS; i++) {
+        /* The divisor must be normalized.  */
+        uint64_t b = rand64() | (1ULL << 63);
+        uint64_t a0 = rand64(), a1 = rand64();
+
+        if (i & 1) {
+            /* Keep the quotient within 64 bits most of the time.  */
+            a0 %= b;
+        }
+        g_assert_cmphex(estimateDiv128To64(a0, a1, b), ==,
+                        ref_estimateDiv128To64(a0, a1, b));
+    }
+}
+
+static void test_count_sqrt(void)
+{
+    int i;
+
+    for (i = 0; i < 64; i++) {
+        g_assert_cmpint(countLeadingZeros64(1ULL << i), ==, 63 - i);
+        if (i < 32) {
+            g_assert_cmpint(countLeadingZeros32(1U << i), ==, 31 - i);
+        }
+    }
+    for (i = 0; i < ITERATIONS; i++) {
+        uint32_t a = rand64() | 0x80000000;
+        int aExp = i & 1;
+        double exact = sqrt(a / (aExp ? 2147483648.0 : 1073741824.0))
+                       * 2147483648.0;
+
+        g_assert(fabs(estimateSqrt32(aExp, a) - exact) < 2);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/softfloat-macros/shifts", test_shifts);
+    g_test_add_func("/softfloat-macros/add-sub", test_add_sub);
+    g_test_add_func("/softfloat-macros/mul", test_mul);
+    g_test_add_func("/softfloat-macros/estimate-div", test_div);
+    g_test_add_func("/softfloat-macros/clz-sqrt", test_count_sqrt);
+    return g_test_run();
+}
@@ -0,0 +1,314 @@
+/*
+ * Ordered map from integer ranges to values.
+ *
+ * The runs are the nodes of an AVL tree keyed by their start.  Since
+ * the runs partition [0, limit), the run containing a point is the one
+ * with the highest start not above it.  Each node also records the
+ * size of the longest free run in its subtree, which lets the search
+ * for a free range skip the subtrees that have none large enough.
+ *
+ * Updates only ever insert and remove whole nodes, so that the heights
+ * and the free sizes are recomputed on the way back up the tree.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/host-utils.h"
+#include "qemu/range-map.h"
+
+typedef struct RangeMapNode RangeMapNode;
+
+struct RangeMapNode {
+    uint64_t start;
+    uint64_t end;
+    uint64_t max_free;  /* longest run of value 0 in this subtree */
+    unsigned value;
+    int height;
+    RangeMapNode *left;
+    RangeMapNode *right;
+};
+
+struct RangeMap {
+    RangeMapNode *root;
+    uint64_t limit;
+};
+
+static inline int node_height(RangeMapNode *n)
+{
+    return n ? n->height : 0;
+}
+
+static inline uint64_t node_max_free(RangeMapNode *n)
+{
+    return n ? n->max_free : 0;
+}
+
+static void node_update(RangeMapNode *n)
+{
+    uint64_t run = n->value ? 0 : n->end - n->start;
+
+    n->height = 1 + MAX(node_height(n->left), node_height(n->right));
+    n->max_free = MAX(run, MAX(node_max_free(n->left),
+                                node_max_free(n->right)));
+}
+
+static RangeMapNode *rotate_right(RangeMapNode *n)
+{
+    RangeMapNode *l = n->left;
+
+    n->left = l->right;
+    l->right = n;
+    node_update(n);
+    node_update(l);
+    return l;
+}
+
+static RangeMapNode *rotate_left(RangeMapNode *n)
+{
+    RangeMapNode *r = n->right;
+
+    n->right = r->left;
+    r->left = n;
+    node_update(n);
+    node_update(r);
+    return r;
+}
+
+static RangeMapNode *node_balance(RangeMapNode *n)
+{
+    int diff = node_height(n->left) - node_height(n->right);
+
+    if (diff > 1) {
+        if (node_height(n->left->left) < node_height(n->left->right)) {
+            n->left = rotate_left(n->left);
+        }
+        return rotate_right(n);
+    }
+    if (diff < -1) {
+        if (node_height(n->right->right) < node_height(n->right->left)) {
+            n->right = rotate_right(n->right);
+        }
+        return rotate_left(n);
+    }
+    node_update(n);
+    return n;
+}
+
+static RangeMapNode *node_insert(RangeMapNode *n, RangeMapNode *node)
+{
+    if (!n) {
+        return node;
+    }
+    if (node->start < n->start) {
+        n->left = node_insert(n->left, node);
+    } else {
+        n->right = node_insert(n->right, node);
+    }
+    return node_balance(n);
+}
+
+/* Unlink the lowest node of the subtree N into *MIN.  */
+static RangeMapNode *node_remove_min(RangeMapNode *n, RangeMapNode **min)
+{
+    if (!n->left) {
+        *min = n;
+        return n->right;
+    }
+    n->left = node_remove_min(n->left, min);
+    return node_balance(n);
+}
+
+static RangeMapNode *node_remove(RangeMapNode *n, uint64_t start)
+{
+    if (start < n->start) {
+        n->left = node_remove(n->left, start);
+    } else if (start > n->start) {
+        n->right = node_remove(n->right, start);
+    } else {
+        RangeMapNode *l = n->left;
+        RangeMapNode *r = n->right;
+        RangeMapNode *min;
+
+        g_free(n);
+        if (!r) {
+            return l;
+        }
+        r = node_remove_min(r, &min);
+        min->left = l;
+        min->right = r;
+        n = min;
+    }
+    return node_balance(n);
+}
+
+static void range_map_insert(RangeMap *map, uint64_t start, uint64_t end,
+                             unsigned value)
+{
+    RangeMapNode *n = g_new0(RangeMapNode, 1);
+
+    n->start = start;
+    n->end = end;
+    n->value = value;
+    node_update(n);
+    map->root = node_insert(map->root, n);
+}
+
+static void range_map_remove(RangeMap *map, uint64_t start)
+{
+    map->root = node_remove(map->root, start);
+}
+
+static RangeMapNode *range_map_lookup(RangeMap *map, uint64_t point)
+{
+    RangeMapNode *n = map->root;
+
+    g_assert(point < map->limit);
+    while (n) {
+        if (point < n->start) {
+            n = n->left;
+        } else if (point >= n->end) {
+            n = n->right;
+        } else {
+            return n;
+        }
+    }
+    g_assert_not_reached();
+}
+
+/* Make POINT the start of a run.  */
+static void range_map_split(RangeMap *map, uint64_t point)
+{
+    RangeMapNode *n;
+    uint64_t start, end;
+    unsigned value;
+
+    if (point == map->limit) {
+        return;
+    }
+    n = range_map_lookup(map, point);
+    if (n->start == point) {
+        return;
+    }
+    start = n->start;
+    end = n->end;
+    value = n->value;
+    range_map_remove(map, start);
+    range_map_insert(map, start, point, value);
+    range_map_insert(map, point, end, value);
+}
+
+RangeMap *range_map_new(uint64_t limit)
+{
+    RangeMap *map = g_new0(RangeMap, 1);
+
+    g_assert(limit);
+    map->limit = limit;
+    range_map_insert(map, 0, limit, 0);
+    return map;
+}
+
+static void node_destroy(RangeMapNode *n)
+{
+    if (n) {
+        node_destroy(n->left);
+        node_destroy(n->right);
+        g_free(n);
+    }
+}
+
+void range_map_destroy(RangeMap *map)
+{
+    node_destroy(map->root);
+    g_free(map);
+}
+
+void range_map_set(RangeMap *map, uint64_t start, uint64_t end,
+                   unsigned value)
+{
+    RangeMapNode *n;
+    uint64_t point;
+
+    g_assert(start <= end && end <= map->limit);
+    if (start == end) {
+        return;
+    }
+    n = range_map_lookup(map, start);
+    if (n->value == value && n->end >= end) {
+        return;
+    }
+
+    range_map_split(map, start);
+    range_map_split(map, end);
+    for (point = start; point < end; ) {
+        n = range_map_lookup(map, point);
+        point = n->end;
+        range_map_remove(map, n->start);
+    }
+
+    /* Merge with the neighbours, so that runs stay maximal.  */
+    if (start > 0) {
+        n = range_map_lookup(map, start - 1);
+        if (n->value == value) {
+            start = n->start;
+            range_map_remove(map, start);
+        }
+    }
+    if (end < map->limit) {
+        n = range_map_lookup(map, end);
+        if (n->value == value) {
+            point = n->start;
+            end = n->end;
+            range_map_remove(map, point);
+        }
+    }
+    range_map_insert(map, start, end, value);
+}
+
+unsigned range_map_get(RangeMap *map, uint64_t point,
+                       uint64_t *run_start, uint64_t *run_end)
+{
+    RangeMapNode *n = range_map_lookup(map, point);
+
+    if (run_start) {
+        *run_start = n->start;
+    }
+    if (run_end) {
+        *run_end = n->end;
+    }
+    return n->value;
+}
+
+static bool node_find_free_last(RangeMapNode *n, uint64_t end, uint64_t size,
+                                uint64_t align, uint64_t *start)
+{
+    uint64_t top;
+
+    if (!n || n->max_free < size) {
+        return false;
+    }
+    if (n->start >= end) {
+        return node_find_free_last(n->left, end, size, align, start);
+    }
+    if (node_find_free_last(n->right, end, size, align, start)) {
+        return true;
+    }
+    if (!n->value) {
+        top = MIN(n->end, end);
+        if (top - n->start >= size &&
+            QEMU_ALIGN_DOWN(top - size, align) >= n->start) {
+            *start = QEMU_ALIGN_DOWN(top - size, align);
+            return true;
+        }
+    }
+    return node_find_free_last(n->left, end, size, align, start);
+}
+
+bool range_map_find_free_last(RangeMap *map, uint64_t end, uint64_t size,
+                              uint64_t align, uint64_t *start)
+{
+    g_assert(size && is_power_of_2(align));
+    return node_find_free_last(map->root, MIN(end, map->limit), size, align,
+                               start);
+}
@@ -335,6 +335,21 @@ static QemuOptsList qemu_accel_opts = {
             .type = QEMU_OPT_STRING,
             .help = "Enable/disable multi-threaded TCG",
         },
+        {
+            .name = "perfmap",
+            .type = QEMU_OPT_BOOL,
+            .help = "Generate a /tmp/perf-${pid}.map file for perf",
+        },
+        {
+            .name = "jitdump",
+            .type = QEMU_OPT_BOOL,
+            .help = "Generate a jit-${pid}.dump file for perf",
+        },
+        {
+            .name = "hot-threshold",
+            .type = QEMU_OPT_NUMBER,
+            .help = "Retranslate TBs run this many times as superblocks",
+        },
         { /* end of list */ }
     },
 };